@@ -0,0 +1,528 @@
+#include "benchmarks.h"
+
+#include "culling.h"
+#include "ecs.h"
+#include "frame_graph.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "render_queue.h"
+#include "scene_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename F>
+static double meanMs(int iterations, F&& body) {
+    body();
+    double start = nowMs();
+    for (int i = 0; i < iterations; ++i) body();
+    return (nowMs() - start) / iterations;
+}
+
+void runCullBenchmark(uint32_t count, JobPool* pool) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-200.f, 200.f), size(0.5f, 4.f);
+    CullSpheres spheres;
+    CullBoxes boxes;
+    for (uint32_t i = 0; i < count; ++i) {
+        float x = position(rng), y = position(rng), z = position(rng), r = size(rng);
+        addCullSphere(spheres, x, y, z, r);
+        float lo[3] = { x - r, y - r, z - r }, hi[3] = { x + r, y + r, z + r };
+        addCullBox(boxes, lo, hi);
+    }
+
+    float view[16], projection[16], viewProjection[16];
+    mat4_rotate_y(view, 0.3f);
+    mat4_perspective(projection, 3.1415926f / 4.f, 800.f / 600.f, 0.1f, 300.f);
+    mat4_mul(viewProjection, projection, view);
+    Frustum frustum;
+    extractFrustumPlanes(frustum, viewProjection);
+
+    std::vector<uint32_t> visible(count);
+    printf("Frustum culling %u objects, %u threads, AVX2 %s\n", count, jobPoolThreadCount(pool), cullHasAVX2() ? "yes" : "no");
+    printf("%-8s %-10s %10s %10s %12s\n", "bounds", "mode", "ms", "visible", "Mobjects/s");
+    struct Mode { const char* name; bool scalar; JobPool* pool; } modes[] = {
+        { "scalar", true, nullptr }, { "simd", false, nullptr }, { "simd+jobs", false, pool },
+    };
+    for (const Mode& mode : modes) {
+        cullForceScalar(mode.scalar);
+        uint32_t n = 0;
+        double ms = meanMs(20, [&] { n = cullSpheres(frustum, spheres, visible.data(), mode.pool); });
+        printf("%-8s %-10s %10.3f %10u %12.1f\n", "sphere", mode.name, ms, n, count / ms / 1000.0);
+        ms = meanMs(20, [&] { n = cullBoxes(frustum, boxes, visible.data(), mode.pool); });
+        printf("%-8s %-10s %10.3f %10u %12.1f\n", "aabb", mode.name, ms, n, count / ms / 1000.0);
+    }
+    cullForceScalar(false);
+}
+
+static Mesh makeBoxMesh(float sx, float sy, float sz) {
+    static const uint32_t faces[36] = { 0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+                                        2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3 };
+    Mesh mesh = { new Vertex[8], new uint32_t[36], 8, 36 };
+    for (int c = 0; c < 8; ++c) {
+        mesh.vertices[c] = Vertex{};
+        mesh.vertices[c].position = { (c & 1) ? sx : -sx, (c & 2) ? sy : -sy, (c & 4) ? sz : -sz };
+    }
+    memcpy(mesh.indices, faces, sizeof(faces));
+    return mesh;
+}
+
+void runOcclusionBenchmark(uint32_t count, JobPool* pool) {
+    // A row of wide walls in front of a field of small boxes, camera at the origin looking down -z.
+    Mesh wall = makeBoxMesh(4.f, 20.f, 0.5f);
+    std::vector<float> wallModels;
+    for (int i = 0; i < 8; ++i) {
+        float m[16];
+        mat4_translate(m, -42.f + i * 12.f, 0.f, -30.f);
+        wallModels.insert(wallModels.end(), m, m + 16);
+    }
+
+    std::mt19937 rng(99);
+    std::uniform_real_distribution<float> depth(-200.f, -5.f), side(-1.f, 1.f), size(0.2f, 1.5f);
+    CullSpheres spheres;
+    for (uint32_t i = 0; i < count; ++i) {
+        float z = depth(rng);
+        addCullSphere(spheres, side(rng) * -z * 0.5f, side(rng) * -z * 0.4f, z, size(rng));
+    }
+
+    float viewProjection[16];
+    mat4_perspective(viewProjection, 3.1415926f / 4.f, 800.f / 600.f, 0.1f, 300.f);
+    Frustum frustum;
+    extractFrustumPlanes(frustum, viewProjection);
+    std::vector<uint32_t> visible(count);
+    uint32_t inFrustum = cullSpheres(frustum, spheres, visible.data(), pool);
+    std::vector<uint32_t> survivors(inFrustum);
+
+    OcclusionBuffer buffer = createOcclusionBuffer(256, 192);
+    uint32_t passed = 0;
+    double rasterMs = meanMs(50, [&] {
+        beginOcclusionFrame(buffer, viewProjection);
+        for (size_t i = 0; i < wallModels.size() / 16; ++i) addOccluder(buffer, wall, &wallModels[i * 16]);
+        rasterizeOccluders(buffer, pool);
+    });
+    double pyramidMs = meanMs(50, [&] { buildDepthPyramid(buffer); });
+    double testMs = meanMs(20, [&] {
+        std::copy(visible.begin(), visible.begin() + inFrustum, survivors.begin());
+        passed = cullOccludedSpheres(buffer, spheres, survivors.data(), inFrustum, pool);
+    });
+
+    printf("Occlusion culling %u objects, %dx%d depth buffer, %u threads\n", count, buffer.width, buffer.height, jobPoolThreadCount(pool));
+    printf("  %-10s %8zu occluder triangles %8.3f ms\n", "rasterize", buffer.triangles.size(), rasterMs);
+    printf("  %-10s %8zu pyramid levels     %8.3f ms\n", "pyramid", buffer.levels.size(), pyramidMs);
+    printf("  %-10s %8u boxes              %8.3f ms\n", "test", inFrustum, testMs);
+    printf("  in frustum %u, not occluded %u (%.1f%% culled by occlusion)\n", inFrustum, passed,
+           inFrustum ? 100.0 * (inFrustum - passed) / inFrustum : 0.0);
+    freeMesh(wall);
+}
+
+void runQueueSortBenchmark(uint32_t count) {
+    // Keys spread over a few programs, materials, textures and VAOs like a real scene.
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> slot(0, 3);
+    std::uniform_real_distribution<float> depth(0.f, 1.f);
+    std::vector<SortEntry> keys(count), entries(count), scratch(count);
+    for (uint32_t i = 0; i < count; ++i)
+        keys[i] = { makeSortKey(0, slot(rng), slot(rng), slot(rng), slot(rng), depth(rng)), i };
+
+    auto stateChanges = [&](const std::vector<SortEntry>& order) {
+        uint32_t changes = 0;
+        for (uint32_t i = 0; i < count; ++i)
+            if (i == 0 || (order[i].key >> 24) != (order[i - 1].key >> 24)) ++changes;
+        return changes;
+    };
+    uint32_t unsortedChanges = stateChanges(keys);
+
+    double radixMs = meanMs(50, [&] {
+        std::copy(keys.begin(), keys.end(), entries.begin());
+        radixSortEntries(entries.data(), scratch.data(), count);
+    });
+    uint32_t sortedChanges = stateChanges(entries);
+    bool ordered = std::is_sorted(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+    double stdMs = meanMs(50, [&] {
+        std::copy(keys.begin(), keys.end(), entries.begin());
+        std::sort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+    });
+
+    printf("Render queue sort of %u items\n", count);
+    printf("  %-10s %8.3f ms %10.1f Mitems/s%s\n", "radix", radixMs, count / radixMs / 1000.0, ordered ? "" : "  (NOT SORTED)");
+    printf("  %-10s %8.3f ms %10.1f Mitems/s\n", "std::sort", stdMs, count / stdMs / 1000.0);
+    printf("  state changes: %u unsorted, %u sorted\n", unsortedChanges, sortedChanges);
+}
+
+void runMatrixBenchmark(uint32_t count) {
+    // Random rotation, scale and translation, so the affine inverse is valid for every matrix.
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> angle(0.f, 6.2831853f), scale(0.5f, 2.f), offset(-100.f, 100.f);
+    std::vector<float> matrices((size_t)count * 16), out((size_t)count * 16), normals((size_t)count * 12);
+    for (uint32_t i = 0; i < count; ++i) {
+        float* m = &matrices[(size_t)i * 16];
+        float s = scale(rng);
+        mat4_rotate_y(m, angle(rng));
+        for (int j = 0; j < 11; ++j) m[j] *= s;
+        m[12] = offset(rng); m[13] = offset(rng); m[14] = offset(rng);
+    }
+    float rhs[16];
+    mat4_rotate_y(rhs, 0.5f);
+    rhs[13] = 2.f;
+
+    printf("Matrix math over %u matrices, AVX %s\n", count, matrixHasAVX() ? "yes" : "no");
+    printf("%-16s %10s %10s %8s\n", "operation", "scalar ms", "simd ms", "speedup");
+    auto row = [](const char* name, double scalarMs, double simdMs) {
+        printf("%-16s %10.3f %10.3f %7.2fx\n", name, scalarMs, simdMs, scalarMs / simdMs);
+    };
+    const float* m = matrices.data();
+    float* o = out.data();
+    double scalarMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_mul_scalar(o + i * 16, m + i * 16, rhs); });
+    double simdMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_mul(o + i * 16, m + i * 16, rhs); });
+    row("multiply", scalarMs, simdMs);
+    row("multiply batch", scalarMs, meanMs(10, [&] { mat4_mul_batch(o, m, rhs, count); }));
+    scalarMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_inverse_scalar(o + i * 16, m + i * 16); });
+    simdMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_inverse(o + i * 16, m + i * 16); });
+    row("inverse", scalarMs, simdMs);
+    scalarMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_affine_inverse_scalar(o + i * 16, m + i * 16); });
+    simdMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_affine_inverse(o + i * 16, m + i * 16); });
+    row("affine inverse", scalarMs, simdMs);
+    float* n = normals.data();
+    scalarMs = meanMs(10, [&] { for (uint32_t i = 0; i < count; ++i) mat4_normal_matrix_scalar(n + i * 12, m + i * 16); });
+    simdMs = meanMs(10, [&] { mat4_normal_batch(n, m, count); });
+    row("normal matrix", scalarMs, simdMs);
+}
+
+void runFrameGraphBenchmark(uint32_t passCount) {
+    // Passes each write one or two new textures and read the latest one plus a few other
+    // recent ones, like chains of post effects. One in ten is a debug view nothing reads,
+    // left for culling. The passes are declared in a shuffled order, so the compiler has
+    // to recover the real one.
+    std::mt19937 rng(99);
+    const FrameGraphTextureDesc descs[] = {
+        { 1920, 1080, FRAME_GRAPH_RGBA8 }, { 1920, 1080, FRAME_GRAPH_RGBA16F }, { 1920, 1080, FRAME_GRAPH_DEPTH24 },
+        { 960, 540, FRAME_GRAPH_RGBA16F }, { 480, 270, FRAME_GRAPH_RGBA8 },
+    };
+    struct PassSpec { std::vector<uint32_t> reads, writes; };
+    FrameGraph graph;
+    uint32_t output = importFrameGraphTarget(graph, "output", descs[0], 0);
+    std::vector<PassSpec> specs(passCount);
+    std::vector<uint32_t> recent;
+    for (uint32_t p = 0; p < passCount; ++p) {
+        PassSpec& spec = specs[p];
+        if (!recent.empty()) spec.reads.push_back(recent.back());
+        uint32_t reads = recent.empty() ? 0 : rng() % 3;
+        for (uint32_t i = 0; i < reads; ++i) {
+            uint32_t r = recent[recent.size() - 1 - rng() % std::min<size_t>(recent.size(), 8)];
+            if (std::find(spec.reads.begin(), spec.reads.end(), r) == spec.reads.end()) spec.reads.push_back(r);
+        }
+        if (p + 1 == passCount) {
+            spec.writes.push_back(output);
+            break;
+        }
+        bool debugView = rng() % 10 == 0;
+        uint32_t writes = 1 + rng() % 2;
+        for (uint32_t i = 0; i < writes; ++i) {
+            std::string name = "t" + std::to_string(graph.resources.size());
+            uint32_t r = createFrameGraphTexture(graph, name.c_str(), descs[rng() % 5]);
+            spec.writes.push_back(r);
+            if (!debugView) recent.push_back(r);
+        }
+    }
+    std::vector<uint32_t> declaration(passCount);
+    for (uint32_t i = 0; i < passCount; ++i) declaration[i] = i;
+    std::shuffle(declaration.begin(), declaration.end(), rng);
+    for (uint32_t p : declaration) {
+        std::string name = "pass" + std::to_string(p);
+        addFrameGraphPass(graph, name.c_str(), specs[p].reads, specs[p].writes);
+    }
+
+    double ms = meanMs(100, [&] { compileFrameGraph(graph); });
+
+    // Check the schedule: writers before readers, kept passes all contribute to the
+    // output, and textures sharing a slot are never alive at the same time.
+    uint32_t errors = 0;
+    std::vector<uint32_t> position(graph.passes.size(), FRAME_GRAPH_NONE);
+    for (uint32_t i = 0; i < graph.order.size(); ++i) position[graph.order[i]] = i;
+    std::vector<bool> read(graph.resources.size(), false);
+    for (uint32_t p : graph.order) {
+        for (uint32_t r : graph.passes[p].reads) {
+            read[r] = true;
+            for (uint32_t writer : graph.resources[r].writers) errors += position[writer] >= position[p];
+        }
+    }
+    for (uint32_t p : graph.order) {
+        bool used = false;
+        for (uint32_t r : graph.passes[p].writes) used |= read[r] || graph.resources[r].imported;
+        errors += !used;
+    }
+    for (const FrameGraphResource& a : graph.resources) {
+        for (const FrameGraphResource& b : graph.resources) {
+            if (&a != &b && a.physical != FRAME_GRAPH_NONE && a.physical == b.physical)
+                errors += a.firstUse <= b.lastUse && b.firstUse <= a.lastUse;
+        }
+    }
+
+    uint32_t transients = 0;
+    for (const FrameGraphResource& resource : graph.resources) transients += resource.physical != FRAME_GRAPH_NONE;
+    FrameGraphMemory memory = frameGraphMemory(graph);
+    printf("Frame graph of %u passes declared in shuffled order\n", passCount);
+    printf("  %-22s %u run, %zu culled\n", "passes", (uint32_t)graph.order.size(), graph.passes.size() - graph.order.size());
+    printf("  %-22s %u textures in %zu physical textures\n", "transients", transients, graph.physical.size());
+    printf("  %-22s %.1f MB without aliasing, %.1f MB with\n", "memory", memory.transientBytes / 1048576.0, memory.physicalBytes / 1048576.0);
+    printf("  %-22s %.3f ms\n", "compile", ms);
+    printf("  %-22s %s (%u errors)\n", "schedule checks", errors ? "FAILED" : "passed", errors);
+}
+
+void runSceneGraphBenchmark(uint32_t nodeCount, JobPool* pool) {
+    // A forest of a thousand roots where every other node hangs off a random earlier one,
+    // which gives deep and uneven subtrees.
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> offset(-2.f, 2.f), angle(-3.14159f, 3.14159f), size(0.8f, 1.2f);
+    auto randomDesc = [&](uint32_t parent) {
+        float a = angle(rng) * 0.5f;
+        SceneNodeDesc desc = { parent, { offset(rng), offset(rng), offset(rng) }, { 0.f, sinf(a), 0.f, cosf(a) }, size(rng) };
+        return desc;
+    };
+    uint32_t roots = std::min(nodeCount, 1000u);
+    std::vector<SceneNodeDesc> descs;
+    descs.reserve(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; ++i) descs.push_back(randomDesc(i < roots ? SCENE_NO_PARENT : (uint32_t)(rng() % i)));
+    SceneGraph graph = createSceneGraph(descs);
+
+    printf("Scene graph of %u nodes in %zu levels, %u threads\n", nodeCount, graph.levelStart.size() - 1, jobPoolThreadCount(pool));
+    printf("%-26s %10s %12s %10s\n", "update", "ms", "nodes", "Mnodes/s");
+    struct Mode { const char* name; bool scalar; JobPool* pool; } modes[] = {
+        { "full scalar", true, nullptr }, { "full sse", false, nullptr }, { "full sse+jobs", false, pool },
+    };
+    for (const Mode& mode : modes) {
+        sceneGraphForceScalar(mode.scalar);
+        double ms = meanMs(10, [&] { updateAllSceneGraph(graph, mode.pool); });
+        printf("%-26s %10.3f %12u %10.1f\n", mode.name, ms, nodeCount, nodeCount / ms / 1000.0);
+    }
+    sceneGraphForceScalar(false);
+
+    // Incremental updates: move a fraction of the nodes each frame and let the dirty
+    // subtrees propagate.
+    const double fractions[] = { 0.001, 0.01 };
+    for (double fraction : fractions) {
+        uint32_t changes = std::max(1u, (uint32_t)(nodeCount * fraction));
+        const int frames = 20;
+        uint64_t touched = 0;
+        double ms = 0.0;
+        for (int f = 0; f < frames; ++f) {
+            for (uint32_t i = 0; i < changes; ++i) {
+                SceneNodeDesc desc = randomDesc(0);
+                setLocalTransform(graph, rng() % nodeCount, desc.translation, desc.rotation, desc.scale);
+            }
+            double start = nowMs();
+            touched += updateSceneGraph(graph, pool);
+            ms += nowMs() - start;
+        }
+        std::string name = "incremental " + std::to_string(changes) + " changed";
+        printf("%-26s %10.3f %12u %10.1f\n", name.c_str(), ms / frames, (uint32_t)(touched / frames), touched / ms / 1000.0);
+    }
+
+    // The incremental results must match a scalar recompute from scratch.
+    std::vector<float> incremental = graph.world;
+    sceneGraphForceScalar(true);
+    updateAllSceneGraph(graph, nullptr);
+    sceneGraphForceScalar(false);
+    float maxError = 0.f;
+    for (size_t i = 0; i < incremental.size(); ++i) maxError = std::max(maxError, fabsf(incremental[i] - graph.world[i]));
+    printf("  %-24s %g\n", "max error", maxError);
+}
+
+void runJobBenchmark(uint32_t maxThreads, bool pin) {
+    // Three workloads per thread count: culling a million spheres and a full update of a
+    // million-node scene graph, both parallelFor over large ranges, and a graph of small
+    // jobs in dependent stages that mostly measures scheduling overhead.
+    const uint32_t objects = 1000000, stages = 16, stageJobs = 4096;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> position(-200.f, 200.f), size(0.5f, 4.f);
+    CullSpheres spheres;
+    for (uint32_t i = 0; i < objects; ++i) addCullSphere(spheres, position(rng), position(rng), position(rng), size(rng));
+    float view[16], projection[16], viewProjection[16];
+    mat4_rotate_y(view, 0.3f);
+    mat4_perspective(projection, 3.1415926f / 4.f, 800.f / 600.f, 0.1f, 300.f);
+    mat4_mul(viewProjection, projection, view);
+    Frustum frustum;
+    extractFrustumPlanes(frustum, viewProjection);
+    std::vector<uint32_t> visible(objects);
+
+    std::vector<SceneNodeDesc> descs(objects);
+    for (uint32_t i = 0; i < objects; ++i)
+        descs[i] = { i < 1000 ? SCENE_NO_PARENT : (uint32_t)(rng() % i), { position(rng), 0.f, 0.f }, { 0.f, 0.f, 0.f, 1.f }, 1.f };
+    SceneGraph graph = createSceneGraph(descs);
+    std::vector<float> stageResults((size_t)stages * stageJobs);
+
+    printf("Job system scalability, %u hardware threads%s\n", std::max(1u, std::thread::hardware_concurrency()), pin ? ", workers pinned" : "");
+    printf("%8s %10s %8s %10s %8s %12s %8s %10s\n", "threads", "cull ms", "speedup", "scene ms", "speedup", "job graph ms", "speedup", "steals");
+    double base[3] = {};
+    for (uint32_t threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1) {
+        JobPool* pool = createJobPool(threads - 1, pin);
+        double cullMs = meanMs(10, [&] { cullSpheres(frustum, spheres, visible.data(), pool); });
+        double sceneMs = meanMs(5, [&] { updateAllSceneGraph(graph, pool); });
+        // Each stage's jobs start once the previous stage has finished.
+        double graphMs = meanMs(5, [&] {
+            std::vector<JobCounter> counters(stages);
+            for (uint32_t s = 0; s < stages; ++s) {
+                for (uint32_t j = 0; j < stageJobs; ++j) {
+                    runJob(pool, [&, s, j] {
+                        float v = s > 0 ? stageResults[(size_t)(s - 1) * stageJobs + j] : (float)j;
+                        for (int k = 0; k < 200; ++k) v = v * 0.999f + 0.5f;
+                        stageResults[(size_t)s * stageJobs + j] = v;
+                    }, &counters[s], s > 0 ? &counters[s - 1] : nullptr);
+                }
+            }
+            waitForCounter(pool, counters[stages - 1]);
+        });
+        uint64_t steals = pool->steals.load();
+        freeJobPool(pool);
+        if (threads == 1) base[0] = cullMs, base[1] = sceneMs, base[2] = graphMs;
+        printf("%8u %10.3f %7.2fx %10.3f %7.2fx %12.3f %7.2fx %10llu\n", threads, cullMs, base[0] / cullMs, sceneMs, base[1] / sceneMs,
+               graphMs, base[2] / graphMs, (unsigned long long)steals);
+    }
+}
+
+void runEcsBenchmark(uint32_t entityCount, JobPool* pool) {
+    // Creates the entities with random component sets, then churns them: destroys some,
+    // creates others and moves entities between archetypes by adding and removing
+    // components. A plain array mirrors what every entity should hold, and each component
+    // is stamped with its entity's serial number so a row moved to the wrong place shows.
+    std::mt19937 rng(5);
+    struct Shadow { Entity entity; ComponentMask mask; uint32_t serial; };
+    std::vector<Shadow> live;
+    std::vector<Entity> stale;
+    uint32_t serials = 0, errors = 0;
+    auto stamp = [&](EcsWorld& world, const Shadow& s, ComponentMask components) {
+        if (components & componentBit(ECS_TRANSFORM)) ((Transform*)entityComponent(world, s.entity, ECS_TRANSFORM))->model[0] = (float)s.serial;
+        if (components & componentBit(ECS_MESH)) ((MeshRef*)entityComponent(world, s.entity, ECS_MESH))->mesh = s.serial;
+        if (components & componentBit(ECS_MATERIAL)) ((MaterialRef*)entityComponent(world, s.entity, ECS_MATERIAL))->textureSlot = s.serial;
+        if (components & componentBit(ECS_BOUNDS)) ((Bounds*)entityComponent(world, s.entity, ECS_BOUNDS))->radius = (float)s.serial;
+    };
+    // Components just added must read zero before they are stamped.
+    auto zeroed = [&](EcsWorld& world, const Shadow& s, ComponentMask components) {
+        bool zero = true;
+        if (components & componentBit(ECS_TRANSFORM)) zero &= ((Transform*)entityComponent(world, s.entity, ECS_TRANSFORM))->model[0] == 0.f;
+        if (components & componentBit(ECS_MESH)) zero &= ((MeshRef*)entityComponent(world, s.entity, ECS_MESH))->mesh == 0;
+        if (components & componentBit(ECS_MATERIAL)) zero &= ((MaterialRef*)entityComponent(world, s.entity, ECS_MATERIAL))->textureSlot == 0;
+        if (components & componentBit(ECS_BOUNDS)) zero &= ((Bounds*)entityComponent(world, s.entity, ECS_BOUNDS))->radius == 0.f;
+        return zero;
+    };
+    const ComponentMask allComponents = (1u << ECS_COMPONENT_COUNT) - 1;
+    auto randomMask = [&] { return componentBit(ECS_TRANSFORM) | (ComponentMask)(rng() & allComponents); };
+
+    EcsWorld world = createEcsWorld();
+    double start = nowMs();
+    for (uint32_t i = 0; i < entityCount; ++i) {
+        Shadow s = { 0, randomMask(), serials++ };
+        s.entity = createEntity(world, s.mask);
+        live.push_back(s);
+    }
+    double createMs = nowMs() - start;
+    for (const Shadow& s : live) {
+        errors += !zeroed(world, s, s.mask);
+        stamp(world, s, s.mask);
+    }
+
+    start = nowMs();
+    uint32_t moves = 0;
+    for (uint32_t op = 0; op < entityCount; ++op) {
+        uint32_t choice = rng() % 4;
+        if (live.empty()) choice = 0;
+        if (choice == 0) {
+            Shadow s = { 0, randomMask(), serials++ };
+            s.entity = createEntity(world, s.mask);
+            errors += !zeroed(world, s, s.mask);
+            stamp(world, s, s.mask);
+            live.push_back(s);
+            continue;
+        }
+        size_t pick = rng() % live.size();
+        Shadow& s = live[pick];
+        if (choice == 1) {
+            destroyEntity(world, s.entity);
+            stale.push_back(s.entity);
+            s = live.back();
+            live.pop_back();
+        } else if (choice == 2) {
+            ComponentMask added = (ComponentMask)(rng() & allComponents) & ~s.mask;
+            addComponents(world, s.entity, added);
+            s.mask |= added;
+            errors += !zeroed(world, s, added);
+            stamp(world, s, added);
+            moves += added != 0;
+        } else {
+            ComponentMask removed = (ComponentMask)(rng() & allComponents) & s.mask & ~componentBit(ECS_TRANSFORM);
+            removeComponents(world, s.entity, removed);
+            s.mask &= ~removed;
+            moves += removed != 0;
+        }
+    }
+    double churnMs = nowMs() - start;
+
+    // Every surviving entity keeps its components and values, stale handles are caught
+    // unless their slot has been reused often enough for the 8-bit generation to wrap,
+    // and each query sees exactly the entities whose sets include its components.
+    std::vector<uint32_t> destroyedAt;
+    for (Entity e : stale) {
+        uint32_t index = e & 0xFFFFFF;
+        if (index >= destroyedAt.size()) destroyedAt.resize(index + 1, 0);
+        ++destroyedAt[index];
+    }
+    for (Entity e : stale) errors += entityAlive(world, e) && destroyedAt[e & 0xFFFFFF] < 256;
+    for (const Shadow& s : live) {
+        if (!entityAlive(world, s.entity) || entityComponents(world, s.entity) != s.mask) {
+            ++errors;
+            continue;
+        }
+        for (int c = 0; c < ECS_COMPONENT_COUNT; ++c) {
+            if (!(s.mask & (1u << c))) continue;
+            void* value = entityComponent(world, s.entity, (EcsComponent)c);
+            if (c == ECS_TRANSFORM) errors += ((Transform*)value)->model[0] != (float)s.serial;
+            if (c == ECS_MESH) errors += ((MeshRef*)value)->mesh != s.serial;
+            if (c == ECS_MATERIAL) errors += ((MaterialRef*)value)->textureSlot != s.serial;
+            if (c == ECS_BOUNDS) errors += ((Bounds*)value)->radius != (float)s.serial;
+        }
+    }
+
+    EcsQuery query;
+    double queryMs = 0.0;
+    uint64_t rowsVisited = 0;
+    for (ComponentMask mask = 0; mask <= allComponents; ++mask) {
+        uint32_t expected = 0;
+        for (const Shadow& s : live) expected += (s.mask & mask) == mask;
+        start = nowMs();
+        runEcsQuery(world, mask, query);
+        std::vector<uint32_t> wrong(query.views.size(), 0);
+        parallelForQuery(pool, query, [&](const EcsView& view) {
+            const Entity* entities = ecsEntities(view);
+            uint32_t bad = 0;
+            for (uint32_t row = 0; row < view.count; ++row)
+                bad += (view.archetype->mask & mask) != mask || !entityAlive(world, entities[row]);
+            wrong[&view - query.views.data()] = bad;
+        });
+        queryMs += nowMs() - start;
+        rowsVisited += query.count;
+        errors += query.count != expected;
+        for (uint32_t bad : wrong) errors += bad;
+    }
+
+    size_t chunks = 0;
+    for (const EcsArchetype& archetype : world.archetypes) chunks += archetype.chunks.size();
+    printf("ECS of %u entities over %zu archetypes, %u threads\n", entityCount, world.archetypes.size(), jobPoolThreadCount(pool));
+    printf("  %-22s %.3f ms\n", "create", createMs);
+    printf("  %-22s %.3f ms for %u operations, %u archetype moves\n", "churn", churnMs, entityCount, moves);
+    printf("  %-22s %.3f ms over %llu rows in %u queries\n", "query", queryMs, (unsigned long long)rowsVisited, allComponents + 1);
+    printf("  %-22s %zu in use, %zu free for reuse\n", "chunks", chunks, world.freeChunks.size());
+    printf("  %-22s %s (%u errors)\n", "checks", errors ? "FAILED" : "passed", errors);
+    freeEcsWorld(world);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "job_pool.h"
+
+#include <cstdint>
+
+// Headless CPU benchmarks; they print their results and need no GL context.
+
+void runCullBenchmark(uint32_t count, JobPool* pool);
+void runOcclusionBenchmark(uint32_t count, JobPool* pool);
+void runQueueSortBenchmark(uint32_t count);
+void runMatrixBenchmark(uint32_t count);
+void runFrameGraphBenchmark(uint32_t passes);
+void runSceneGraphBenchmark(uint32_t nodes, JobPool* pool);
+void runEcsBenchmark(uint32_t entities, JobPool* pool);
+void runJobBenchmark(uint32_t maxThreads, bool pin);
@@ -0,0 +1,190 @@
+#include "clustered_lights.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CLUSTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+static void createTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format) {
+    glGenBuffers(1, &buffer);
+    cachedBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    cachedBindTexture(0, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+static void uploadTextureBuffer(GLuint buffer, const void* data, size_t size) {
+    cachedBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // Orphan the old storage so the GPU can keep reading last frame's lists.
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), nullptr, GL_STREAM_DRAW);
+    if (size) glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+ClusteredLights createClusteredLights() {
+    ClusteredLights clusters = {};
+    createTextureBuffer(clusters.lightBuffer, clusters.lightTexture, GL_RGBA32F);
+    createTextureBuffer(clusters.clusterBuffer, clusters.clusterTexture, GL_RG32UI);
+    createTextureBuffer(clusters.indexBuffer, clusters.indexTexture, GL_R32UI);
+    clusters.sliceIndices.resize(CLUSTER_Z);
+    clusters.clusterCounts.assign(CLUSTER_COUNT, 0);
+    clusters.clusterTexels.assign((size_t)CLUSTER_COUNT * 2, 0);
+    uploadTextureBuffer(clusters.clusterBuffer, clusters.clusterTexels.data(), clusters.clusterTexels.size() * sizeof(uint32_t));
+    return clusters;
+}
+
+void freeClusteredLights(ClusteredLights& clusters) {
+    GLuint buffers[3] = { clusters.lightBuffer, clusters.clusterBuffer, clusters.indexBuffer };
+    GLuint textures[3] = { clusters.lightTexture, clusters.clusterTexture, clusters.indexTexture };
+    cachedDeleteBuffers(3, buffers);
+    cachedDeleteTextures(3, textures);
+    clusters = {};
+}
+
+static float sliceDepth(const ClusteredLights& c, int slice) {
+    return c.zNear * powf(c.zFar / c.zNear, (float)slice / CLUSTER_Z);
+}
+
+static void buildClusterBounds(ClusteredLights& c) {
+    c.boundsMin.resize((size_t)CLUSTER_COUNT * 3);
+    c.boundsMax.resize((size_t)CLUSTER_COUNT * 3);
+    float tanY = tanf(c.fovy * 0.5f), tanX = tanY * c.aspect;
+    for (int z = 0; z < CLUSTER_Z; ++z) {
+        float depths[2] = { sliceDepth(c, z), sliceDepth(c, z + 1) };
+        for (int y = 0; y < CLUSTER_Y; ++y) {
+            for (int x = 0; x < CLUSTER_X; ++x) {
+                // Tile edges in NDC, with row 0 at the bottom like gl_FragCoord.
+                float ndcX[2] = { -1.f + 2.f * x / CLUSTER_X, -1.f + 2.f * (x + 1) / CLUSTER_X };
+                float ndcY[2] = { -1.f + 2.f * y / CLUSTER_Y, -1.f + 2.f * (y + 1) / CLUSTER_Y };
+                float* lo = &c.boundsMin[(size_t)((z * CLUSTER_Y + y) * CLUSTER_X + x) * 3];
+                float* hi = &c.boundsMax[(size_t)((z * CLUSTER_Y + y) * CLUSTER_X + x) * 3];
+                lo[0] = lo[1] = 1e30f; hi[0] = hi[1] = -1e30f;
+                for (float d : depths) {
+                    for (int i = 0; i < 2; ++i) {
+                        lo[0] = std::min(lo[0], ndcX[i] * tanX * d); hi[0] = std::max(hi[0], ndcX[i] * tanX * d);
+                        lo[1] = std::min(lo[1], ndcY[i] * tanY * d); hi[1] = std::max(hi[1], ndcY[i] * tanY * d);
+                    }
+                }
+                lo[2] = -depths[1];
+                hi[2] = -depths[0];
+            }
+        }
+    }
+}
+
+// Appends to out every light in the padded SoA arrays whose sphere touches the box.
+static void testLights(const float* x, const float* y, const float* z, const float* r, const uint32_t* ids,
+                       uint32_t count, const float* lo, const float* hi, std::vector<uint32_t>& out) {
+#ifdef CLUSTER_SSE
+    __m128 loX = _mm_set1_ps(lo[0]), loY = _mm_set1_ps(lo[1]), loZ = _mm_set1_ps(lo[2]);
+    __m128 hiX = _mm_set1_ps(hi[0]), hiY = _mm_set1_ps(hi[1]), hiZ = _mm_set1_ps(hi[2]);
+    for (uint32_t i = 0; i < count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i), radius = _mm_loadu_ps(r + i);
+        __m128 dx = _mm_sub_ps(cx, _mm_min_ps(_mm_max_ps(cx, loX), hiX));
+        __m128 dy = _mm_sub_ps(cy, _mm_min_ps(_mm_max_ps(cy, loY), hiY));
+        __m128 dz = _mm_sub_ps(cz, _mm_min_ps(_mm_max_ps(cz, loZ), hiZ));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(radius, radius)));
+        for (int lane = 0; mask; ++lane, mask >>= 1)
+            if (mask & 1) out.push_back(ids[i + lane]);
+    }
+#else
+    for (uint32_t i = 0; i < count; ++i) {
+        float dx = x[i] - std::min(std::max(x[i], lo[0]), hi[0]);
+        float dy = y[i] - std::min(std::max(y[i], lo[1]), hi[1]);
+        float dz = z[i] - std::min(std::max(z[i], lo[2]), hi[2]);
+        if (dx * dx + dy * dy + dz * dz <= r[i] * r[i]) out.push_back(ids[i]);
+    }
+#endif
+}
+
+void assignLights(ClusteredLights& c, const PointLight* lights, uint32_t count, const float* view,
+                  float fovy, float aspect, float zNear, float zFar, JobPool* pool) {
+    if (c.boundsMin.empty() || fovy != c.fovy || aspect != c.aspect || zNear != c.zNear || zFar != c.zFar) {
+        c.fovy = fovy; c.aspect = aspect; c.zNear = zNear; c.zFar = zFar;
+        buildClusterBounds(c);
+    }
+
+    // View-space lights, padded with zero-radius lights far behind the camera that touch nothing.
+    uint32_t padded = (count + 3) & ~3u;
+    c.lightX.assign(padded, 0.f); c.lightY.assign(padded, 0.f); c.lightZ.assign(padded, 1e30f); c.lightRadius.assign(padded, 0.f);
+    c.lightTexels.resize((size_t)count * 8);
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* p = lights[i].position;
+        float v[3];
+        for (int row = 0; row < 3; ++row) v[row] = view[row] * p[0] + view[4 + row] * p[1] + view[8 + row] * p[2] + view[12 + row];
+        c.lightX[i] = v[0]; c.lightY[i] = v[1]; c.lightZ[i] = v[2]; c.lightRadius[i] = lights[i].radius;
+        float* texel = &c.lightTexels[(size_t)i * 8];
+        texel[0] = v[0]; texel[1] = v[1]; texel[2] = v[2]; texel[3] = lights[i].radius;
+        texel[4] = lights[i].color[0]; texel[5] = lights[i].color[1]; texel[6] = lights[i].color[2]; texel[7] = 0.f;
+    }
+
+    // One job per depth slice: gather the lights overlapping the slice's depth range, then
+    // test them against each of the slice's boxes.
+    parallelFor(pool, CLUSTER_Z, 1, [&](uint32_t begin, uint32_t end) {
+        std::vector<float> x, y, z, r;
+        std::vector<uint32_t> ids;
+        for (uint32_t slice = begin; slice < end; ++slice) {
+            float sliceNear = -sliceDepth(c, (int)slice), sliceFar = -sliceDepth(c, (int)slice + 1);
+            x.clear(); y.clear(); z.clear(); r.clear(); ids.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+                if (c.lightZ[i] - c.lightRadius[i] > sliceNear || c.lightZ[i] + c.lightRadius[i] < sliceFar) continue;
+                x.push_back(c.lightX[i]); y.push_back(c.lightY[i]); z.push_back(c.lightZ[i]); r.push_back(c.lightRadius[i]);
+                ids.push_back(i);
+            }
+            while (ids.size() & 3) { x.push_back(0.f); y.push_back(0.f); z.push_back(1e30f); r.push_back(0.f); ids.push_back(0); }
+
+            std::vector<uint32_t>& out = c.sliceIndices[slice];
+            out.clear();
+            for (int cluster = (int)slice * CLUSTER_X * CLUSTER_Y; cluster < ((int)slice + 1) * CLUSTER_X * CLUSTER_Y; ++cluster) {
+                size_t before = out.size();
+                if (!ids.empty())
+                    testLights(x.data(), y.data(), z.data(), r.data(), ids.data(), (uint32_t)ids.size(),
+                               &c.boundsMin[(size_t)cluster * 3], &c.boundsMax[(size_t)cluster * 3], out);
+                c.clusterCounts[cluster] = (uint32_t)(out.size() - before);
+            }
+        }
+    });
+
+    // Slices hold their clusters in order, so concatenating them yields the compact list.
+    c.indices.clear();
+    c.maxClusterLights = 0;
+    for (int slice = 0; slice < CLUSTER_Z; ++slice)
+        c.indices.insert(c.indices.end(), c.sliceIndices[slice].begin(), c.sliceIndices[slice].end());
+    uint32_t offset = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+        c.clusterTexels[(size_t)cluster * 2] = offset;
+        c.clusterTexels[(size_t)cluster * 2 + 1] = c.clusterCounts[cluster];
+        offset += c.clusterCounts[cluster];
+        c.maxClusterLights = std::max(c.maxClusterLights, c.clusterCounts[cluster]);
+    }
+    c.lightCount = count;
+
+    uploadTextureBuffer(c.lightBuffer, c.lightTexels.data(), c.lightTexels.size() * sizeof(float));
+    uploadTextureBuffer(c.clusterBuffer, c.clusterTexels.data(), c.clusterTexels.size() * sizeof(uint32_t));
+    uploadTextureBuffer(c.indexBuffer, c.indices.data(), c.indices.size() * sizeof(uint32_t));
+}
+
+void bindClusteredLights(const ClusteredLights& clusters) {
+    cachedBindTexture(CLUSTER_LIGHT_UNIT, GL_TEXTURE_BUFFER, clusters.lightTexture);
+    cachedBindTexture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, clusters.clusterTexture);
+    cachedBindTexture(CLUSTER_INDEX_UNIT, GL_TEXTURE_BUFFER, clusters.indexTexture);
+}
+
+void clusterFrameParams(const ClusteredLights& clusters, int width, int height, float* out) {
+    if (clusters.zNear <= 0.f) {
+        // Nothing assigned yet: every fragment reads cluster 0, which is empty.
+        memset(out, 0, 4 * sizeof(float));
+        return;
+    }
+    float logRange = logf(clusters.zFar / clusters.zNear);
+    out[0] = (float)CLUSTER_X / width;
+    out[1] = (float)CLUSTER_Y / height;
+    out[2] = CLUSTER_Z / logRange;
+    out[3] = -CLUSTER_Z * logf(clusters.zNear) / logRange;
+}
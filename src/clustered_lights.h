@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "job_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Clustered forward shading. The view frustum is cut into a froxel grid (screen tiles times
+// exponential depth slices); every frame the point lights are assigned to the froxels their
+// spheres touch, on the job pool with SSE sphere/box tests, and the compact per-cluster index
+// lists are uploaded through texture buffers. The fragment shader looks up its froxel and
+// loops over that cluster's lights only. The grid size must match CLUSTER_X/Y/Z in the shader.
+
+const int CLUSTER_X = 16, CLUSTER_Y = 9, CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+// Texture units of the light, cluster and index texture buffers.
+const GLuint CLUSTER_LIGHT_UNIT = 1, CLUSTER_GRID_UNIT = 2, CLUSTER_INDEX_UNIT = 3;
+
+struct PointLight {
+    float position[3];  // world space
+    float radius;       // no contribution beyond this distance
+    float color[3];
+};
+
+struct ClusteredLights {
+    GLuint lightBuffer, lightTexture;      // RGBA32F: view position and radius, then color
+    GLuint clusterBuffer, clusterTexture;  // RG32UI: offset and count per cluster
+    GLuint indexBuffer, indexTexture;      // R32UI light indices
+    float fovy, aspect, zNear, zFar;       // projection the cluster bounds were built for
+    std::vector<float> boundsMin, boundsMax;  // view-space box per cluster, 3 floats each
+    std::vector<float> lightX, lightY, lightZ, lightRadius;  // view space, padded to 4
+    std::vector<float> lightTexels;
+    std::vector<std::vector<uint32_t>> sliceIndices;
+    std::vector<uint32_t> clusterCounts, clusterTexels, indices;
+    uint32_t lightCount;
+    uint32_t maxClusterLights;  // most lights any cluster received last frame
+};
+
+ClusteredLights createClusteredLights();
+void freeClusteredLights(ClusteredLights& clusters);
+// Rebuilds the cluster lists for a perspective projection and uploads them.
+void assignLights(ClusteredLights& clusters, const PointLight* lights, uint32_t count, const float* view,
+                  float fovy, float aspect, float zNear, float zFar, JobPool* pool);
+void bindClusteredLights(const ClusteredLights& clusters);
+// (clusters per pixel in x and y, depth slice scale and bias) for a width x height viewport.
+void clusterFrameParams(const ClusteredLights& clusters, int width, int height, float* out);
@@ -0,0 +1,133 @@
+#include "command_list.h"
+
+#include "gl_state.h"
+#include "matrix.h"
+#include "shader_blocks.h"
+
+#include <cstring>
+
+struct CommandHeader {
+    CommandType type;
+    uint32_t size;
+};
+
+struct BindTextureCommand { GLuint unit; GLenum target; GLuint texture; };
+struct DrawElementsCommand { MeshRange range; uint32_t instanceCount; };
+struct BatchDrawCommand { DrawBatch* batch; MeshRange range; float instance[INSTANCE_FLOATS]; };
+
+static void record(CommandList& list, CommandType type, const void* payload, uint32_t size) {
+    CommandHeader header = { type, size };
+    size_t offset = list.data.size();
+    list.data.resize(offset + sizeof(header) + size);
+    memcpy(&list.data[offset], &header, sizeof(header));
+    memcpy(&list.data[offset + sizeof(header)], payload, size);
+    ++list.commandCount;
+}
+
+void resetCommandList(CommandList& list) {
+    list.data.clear();
+    list.commandCount = 0;
+}
+
+void cmdUseProgram(CommandList& list, GLuint program) {
+    record(list, CMD_USE_PROGRAM, &program, sizeof(program));
+}
+
+void cmdBindTexture(CommandList& list, GLuint unit, GLenum target, GLuint texture) {
+    BindTextureCommand cmd = { unit, target, texture };
+    record(list, CMD_BIND_TEXTURE, &cmd, sizeof(cmd));
+}
+
+void cmdBindVertexArray(CommandList& list, GLuint vao) {
+    record(list, CMD_BIND_VERTEX_ARRAY, &vao, sizeof(vao));
+}
+
+// Normal matrices are computed here, on the recording thread.
+void cmdObjectBlock(CommandList& list, const float* model) {
+    ObjectUniforms object;
+    memcpy(object.model, model, sizeof(object.model));
+    mat4_normal_matrix(object.normalMatrix, model);
+    record(list, CMD_OBJECT_BLOCK, &object, sizeof(object));
+}
+
+void cmdDrawElements(CommandList& list, const MeshRange& range, uint32_t instanceCount) {
+    DrawElementsCommand cmd = { range, instanceCount };
+    record(list, CMD_DRAW_ELEMENTS, &cmd, sizeof(cmd));
+}
+
+void cmdBatchDraw(CommandList& list, DrawBatch* batch, const MeshRange& range, const float* model) {
+    BatchDrawCommand cmd;
+    cmd.batch = batch;
+    cmd.range = range;
+    writeInstances(cmd.instance, model, 1);
+    record(list, CMD_BATCH_DRAW, &cmd, sizeof(cmd));
+}
+
+void replayCommandLists(const CommandList* lists, size_t count, UniformRing& uniforms) {
+    ObjectUniforms identity;
+    mat4_identity(identity.model);
+    mat4_normal_matrix(identity.normalMatrix, identity.model);
+    DrawBatch* pending = nullptr;
+    auto flush = [&] {
+        if (pending) submitDrawBatch(*pending, uniforms, identity);
+        pending = nullptr;
+    };
+
+    for (size_t l = 0; l < count; ++l) {
+        const uint8_t* p = lists[l].data.data();
+        const uint8_t* end = p + lists[l].data.size();
+        while (p < end) {
+            CommandHeader header;
+            memcpy(&header, p, sizeof(header));
+            const uint8_t* payload = p + sizeof(header);
+            p = payload + header.size;
+
+            if (header.type == CMD_BATCH_DRAW) {
+                BatchDrawCommand cmd;
+                memcpy(&cmd, payload, sizeof(cmd));
+                if (cmd.batch != pending) {
+                    flush();
+                    pending = cmd.batch;
+                    clearDrawBatch(*pending);
+                }
+                addDraw(*pending, cmd.range, cmd.instance);
+                continue;
+            }
+
+            flush();
+            switch (header.type) {
+            case CMD_USE_PROGRAM: {
+                GLuint program;
+                memcpy(&program, payload, sizeof(program));
+                cachedUseProgram(program);
+                break;
+            }
+            case CMD_BIND_TEXTURE: {
+                BindTextureCommand cmd;
+                memcpy(&cmd, payload, sizeof(cmd));
+                cachedBindTexture(cmd.unit, cmd.target, cmd.texture);
+                break;
+            }
+            case CMD_BIND_VERTEX_ARRAY: {
+                GLuint vao;
+                memcpy(&vao, payload, sizeof(vao));
+                cachedBindVertexArray(vao);
+                break;
+            }
+            case CMD_OBJECT_BLOCK:
+                uniformRingBindBlock(uniforms, OBJECT_BLOCK_BINDING, payload, sizeof(ObjectUniforms));
+                break;
+            case CMD_DRAW_ELEMENTS: {
+                DrawElementsCommand cmd;
+                memcpy(&cmd, payload, sizeof(cmd));
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)cmd.range.indexCount, GL_UNSIGNED_INT,
+                    (void*)((size_t)cmd.range.firstIndex * sizeof(uint32_t)), (GLsizei)cmd.instanceCount, cmd.range.baseVertex);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+    flush();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "indirect.h"
+#include "mesh_pool.h"
+#include "uniform_ring.h"
+
+#include <cstdint>
+#include <vector>
+
+// Linear buffer of GL commands. Worker threads each record their own list without touching
+// GL, then the GL thread replays the lists in order. Consecutive batch draws are gathered
+// into their DrawBatch during replay and go out as one multi-draw. The buffers keep their
+// capacity when reset, so recording a steady-state frame does not allocate.
+
+enum CommandType : uint32_t {
+    CMD_USE_PROGRAM,
+    CMD_BIND_TEXTURE,
+    CMD_BIND_VERTEX_ARRAY,
+    CMD_OBJECT_BLOCK,
+    CMD_DRAW_ELEMENTS,
+    CMD_BATCH_DRAW,
+};
+
+struct CommandList {
+    std::vector<uint8_t> data;
+    uint32_t commandCount;
+};
+
+void resetCommandList(CommandList& list);
+void cmdUseProgram(CommandList& list, GLuint program);
+void cmdBindTexture(CommandList& list, GLuint unit, GLenum target, GLuint texture);
+void cmdBindVertexArray(CommandList& list, GLuint vao);
+void cmdObjectBlock(CommandList& list, const float* model);
+void cmdDrawElements(CommandList& list, const MeshRange& range, uint32_t instanceCount);
+void cmdBatchDraw(CommandList& list, DrawBatch* batch, const MeshRange& range, const float* model);
+
+void replayCommandLists(const CommandList* lists, size_t count, UniformRing& uniforms);
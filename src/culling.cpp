@@ -0,0 +1,138 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CULL_AVX2 1
+#include <immintrin.h>
+#endif
+
+static const uint32_t CULL_GRAIN = 16384;
+static bool forceScalar = false;
+
+void extractFrustumPlanes(Frustum& frustum, const float* m) {
+    // Rows of the column-major matrix combined as in Gribb & Hartmann.
+    for (int i = 0; i < 3; ++i) {
+        for (int side = 0; side < 2; ++side) {
+            float* p = frustum.planes[i * 2 + side];
+            float sign = side == 0 ? 1.f : -1.f;
+            for (int c = 0; c < 4; ++c) p[c] = m[c * 4 + 3] + sign * m[c * 4 + i];
+            float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            for (int c = 0; c < 4; ++c) p[c] /= len;
+        }
+    }
+}
+
+void addCullSphere(CullSpheres& spheres, float x, float y, float z, float radius) {
+    spheres.x.push_back(x); spheres.y.push_back(y); spheres.z.push_back(z);
+    spheres.radius.push_back(radius);
+}
+
+void addCullBox(CullBoxes& boxes, const float* minCorner, const float* maxCorner) {
+    boxes.x.push_back((minCorner[0] + maxCorner[0]) * 0.5f);
+    boxes.y.push_back((minCorner[1] + maxCorner[1]) * 0.5f);
+    boxes.z.push_back((minCorner[2] + maxCorner[2]) * 0.5f);
+    boxes.extentX.push_back((maxCorner[0] - minCorner[0]) * 0.5f);
+    boxes.extentY.push_back((maxCorner[1] - minCorner[1]) * 0.5f);
+    boxes.extentZ.push_back((maxCorner[2] - minCorner[2]) * 0.5f);
+}
+
+// A sphere or box is visible unless it lies entirely behind one plane. For boxes the
+// radius is the extent projected onto the plane normal.
+static uint32_t cullRangeScalar(const Frustum& f, const float* x, const float* y, const float* z,
+                                const float* r, const float* ex, const float* ey, const float* ez,
+                                uint32_t begin, uint32_t end, uint32_t* out) {
+    uint32_t n = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p) {
+            const float* pl = f.planes[p];
+            float radius = r ? r[i] : fabsf(pl[0]) * ex[i] + fabsf(pl[1]) * ey[i] + fabsf(pl[2]) * ez[i];
+            inside = pl[0] * x[i] + pl[1] * y[i] + pl[2] * z[i] + pl[3] >= -radius;
+        }
+        if (inside) out[n++] = i;
+    }
+    return n;
+}
+
+#ifdef CULL_AVX2
+__attribute__((target("avx2,fma")))
+static uint32_t cullRangeAVX2(const Frustum& f, const float* x, const float* y, const float* z,
+                              const float* r, const float* ex, const float* ey, const float* ez,
+                              uint32_t begin, uint32_t end, uint32_t* out) {
+    __m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(f.planes[p][0]); py[p] = _mm256_set1_ps(f.planes[p][1]);
+        pz[p] = _mm256_set1_ps(f.planes[p][2]); pw[p] = _mm256_set1_ps(f.planes[p][3]);
+        ax[p] = _mm256_set1_ps(fabsf(f.planes[p][0])); ay[p] = _mm256_set1_ps(fabsf(f.planes[p][1]));
+        az[p] = _mm256_set1_ps(fabsf(f.planes[p][2]));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    uint32_t n = 0, i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        __m256 vr = r ? _mm256_loadu_ps(r + i) : zero;
+        __m256 vex = zero, vey = zero, vez = zero;
+        if (!r) { vex = _mm256_loadu_ps(ex + i); vey = _mm256_loadu_ps(ey + i); vez = _mm256_loadu_ps(ez + i); }
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_fmadd_ps(px[p], vx, _mm256_fmadd_ps(py[p], vy, _mm256_fmadd_ps(pz[p], vz, pw[p])));
+            __m256 radius = r ? vr : _mm256_fmadd_ps(ax[p], vex, _mm256_fmadd_ps(ay[p], vey, _mm256_mul_ps(az[p], vez)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, radius), zero, _CMP_GE_OQ));
+        }
+        for (unsigned mask = (unsigned)_mm256_movemask_ps(inside); mask; mask &= mask - 1)
+            out[n++] = i + (uint32_t)__builtin_ctz(mask);
+    }
+    return n + cullRangeScalar(f, x, y, z, r, ex, ey, ez, i, end, out + n);
+}
+#endif
+
+bool cullHasAVX2() {
+#ifdef CULL_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void cullForceScalar(bool scalar) { forceScalar = scalar; }
+
+static uint32_t cullRange(const Frustum& f, const float* x, const float* y, const float* z,
+                          const float* r, const float* ex, const float* ey, const float* ez,
+                          uint32_t begin, uint32_t end, uint32_t* out) {
+#ifdef CULL_AVX2
+    if (!forceScalar && cullHasAVX2()) return cullRangeAVX2(f, x, y, z, r, ex, ey, ez, begin, end, out);
+#endif
+    return cullRangeScalar(f, x, y, z, r, ex, ey, ez, begin, end, out);
+}
+
+// Each chunk writes its visible indices at its own offset, then the chunks are packed together.
+static uint32_t cullParallel(const Frustum& f, const float* x, const float* y, const float* z,
+                             const float* r, const float* ex, const float* ey, const float* ez,
+                             uint32_t count, uint32_t* visible, JobPool* pool) {
+    if (!pool || count <= CULL_GRAIN) return cullRange(f, x, y, z, r, ex, ey, ez, 0, count, visible);
+
+    std::vector<uint32_t> chunkVisible((count + CULL_GRAIN - 1) / CULL_GRAIN);
+    parallelFor(pool, count, CULL_GRAIN, [&](uint32_t begin, uint32_t end) {
+        chunkVisible[begin / CULL_GRAIN] = cullRange(f, x, y, z, r, ex, ey, ez, begin, end, visible + begin);
+    });
+    uint32_t n = chunkVisible[0];
+    for (size_t c = 1; c < chunkVisible.size(); ++c) {
+        memmove(visible + n, visible + c * CULL_GRAIN, chunkVisible[c] * sizeof(uint32_t));
+        n += chunkVisible[c];
+    }
+    return n;
+}
+
+uint32_t cullSpheres(const Frustum& frustum, const CullSpheres& s, uint32_t* visible, JobPool* pool) {
+    return cullParallel(frustum, s.x.data(), s.y.data(), s.z.data(), s.radius.data(), nullptr, nullptr, nullptr,
+                        cullCount(s), visible, pool);
+}
+
+uint32_t cullBoxes(const Frustum& frustum, const CullBoxes& b, uint32_t* visible, JobPool* pool) {
+    return cullParallel(frustum, b.x.data(), b.y.data(), b.z.data(), nullptr, b.extentX.data(), b.extentY.data(),
+                        b.extentZ.data(), cullCount(b), visible, pool);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "job_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Frustum culling over structure-of-arrays bounds. Spheres and boxes are tested eight at a
+// time with AVX2 when the CPU has it (scalar otherwise), large sets are split across a
+// JobPool, and the result is the compacted list of visible indices in their original order.
+
+struct Frustum {
+    float planes[6][4];  // xyz = inward normal, w = distance; a point is inside when dot >= 0
+};
+
+struct CullSpheres {
+    std::vector<float> x, y, z, radius;
+};
+
+// Boxes are stored as centre and half extent.
+struct CullBoxes {
+    std::vector<float> x, y, z, extentX, extentY, extentZ;
+};
+
+void extractFrustumPlanes(Frustum& frustum, const float* viewProjection);
+
+void addCullSphere(CullSpheres& spheres, float x, float y, float z, float radius);
+void addCullBox(CullBoxes& boxes, const float* minCorner, const float* maxCorner);
+inline uint32_t cullCount(const CullSpheres& spheres) { return (uint32_t)spheres.x.size(); }
+inline uint32_t cullCount(const CullBoxes& boxes) { return (uint32_t)boxes.x.size(); }
+
+// visible must hold cullCount() entries; returns how many were written.
+uint32_t cullSpheres(const Frustum& frustum, const CullSpheres& spheres, uint32_t* visible, JobPool* pool = nullptr);
+uint32_t cullBoxes(const Frustum& frustum, const CullBoxes& boxes, uint32_t* visible, JobPool* pool = nullptr);
+
+bool cullHasAVX2();
+void cullForceScalar(bool scalar);
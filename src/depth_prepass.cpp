@@ -0,0 +1,52 @@
+#include "depth_prepass.h"
+
+DepthPrepass createDepthPrepass(PrepassMode mode) {
+    DepthPrepass prepass = {};
+    prepass.mode = mode;
+    prepass.sinceProbe = PREPASS_PROBE_INTERVAL;  // probe on the first frame
+    glGenQueries(PREPASS_QUERY_LATENCY * 2, &prepass.queries[0][0]);
+    return prepass;
+}
+
+void freeDepthPrepass(DepthPrepass& prepass) {
+    glDeleteQueries(PREPASS_QUERY_LATENCY * 2, &prepass.queries[0][0]);
+    prepass = {};
+}
+
+bool beginPrepassFrame(DepthPrepass& prepass) {
+    prepass.slot = (prepass.slot + 1) % PREPASS_QUERY_LATENCY;
+    if (prepass.issued[prepass.slot]) {
+        // A result that is still not ready is dropped rather than waited on.
+        prepass.issued[prepass.slot] = false;
+        GLuint available = 0;
+        glGetQueryObjectuiv(prepass.queries[prepass.slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 depthSamples = 0, shadedSamples = 0;
+            glGetQueryObjectui64v(prepass.queries[prepass.slot][0], GL_QUERY_RESULT, &depthSamples);
+            glGetQueryObjectui64v(prepass.queries[prepass.slot][1], GL_QUERY_RESULT, &shadedSamples);
+            if (shadedSamples > 0) {
+                prepass.overdraw = (float)((double)depthSamples / (double)shadedSamples);
+                if (prepass.overdraw > PREPASS_ENABLE_OVERDRAW) prepass.enabled = true;
+                else if (prepass.overdraw < PREPASS_DISABLE_OVERDRAW) prepass.enabled = false;
+            }
+        }
+    }
+
+    ++prepass.frame;
+    bool draw = prepass.mode == PREPASS_ON;
+    if (prepass.mode == PREPASS_AUTO) {
+        draw = prepass.enabled || ++prepass.sinceProbe >= PREPASS_PROBE_INTERVAL;
+        if (draw) prepass.sinceProbe = 0;
+    }
+    if (draw) ++prepass.prepassFrames;
+    return draw;
+}
+
+void beginPrepassQuery(DepthPrepass& prepass, int pass) {
+    glBeginQuery(GL_SAMPLES_PASSED, prepass.queries[prepass.slot][pass]);
+}
+
+void endPrepassQuery(DepthPrepass& prepass, int pass) {
+    glEndQuery(GL_SAMPLES_PASSED);
+    if (pass == 1) prepass.issued[prepass.slot] = true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Decides per frame whether the scene gets a depth-only prepass before its shading pass.
+// On prepass frames, GL_SAMPLES_PASSED queries count the fragments that pass the depth
+// test in each pass. The prepass draws the same items in the same order with GL_LESS, so
+// its count is what the shading pass alone would shade; the shading pass then runs with
+// GL_LEQUAL and shades each visible pixel once. The ratio of the two is the overdraw.
+// In auto mode a frame without a prepass still runs one every PREPASS_PROBE_INTERVAL
+// frames to measure. The prepass turns on above PREPASS_ENABLE_OVERDRAW and off again
+// below PREPASS_DISABLE_OVERDRAW. Results are read PREPASS_QUERY_LATENCY - 1 frames later,
+// so the queries never stall.
+
+enum PrepassMode { PREPASS_OFF, PREPASS_ON, PREPASS_AUTO };
+
+const int PREPASS_QUERY_LATENCY = 4;
+const uint32_t PREPASS_PROBE_INTERVAL = 60;
+const float PREPASS_ENABLE_OVERDRAW = 1.6f;
+const float PREPASS_DISABLE_OVERDRAW = 1.3f;
+
+struct DepthPrepass {
+    PrepassMode mode;
+    bool enabled;  // auto mode's current decision
+    GLuint queries[PREPASS_QUERY_LATENCY][2];  // prepass, shading pass
+    bool issued[PREPASS_QUERY_LATENCY];
+    int slot;
+    uint64_t frame;
+    uint64_t sinceProbe;
+    float overdraw;  // last measured ratio, 0 before the first measurement
+    uint64_t prepassFrames;
+};
+
+DepthPrepass createDepthPrepass(PrepassMode mode);
+void freeDepthPrepass(DepthPrepass& prepass);
+// Collects finished queries and returns whether this frame draws the prepass.
+bool beginPrepassFrame(DepthPrepass& prepass);
+// Wrap the two passes of a prepass frame; pass 0 is the prepass, 1 the shading pass.
+void beginPrepassQuery(DepthPrepass& prepass, int pass);
+void endPrepassQuery(DepthPrepass& prepass, int pass);
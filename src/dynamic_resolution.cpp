@@ -0,0 +1,54 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+static float clampScale(const ResolutionController& c, float scale) {
+    return std::min(std::max(scale, c.minScale), c.maxScale);
+}
+
+ResolutionController createResolutionController(float budgetMs, float scale, float minScale, float maxScale) {
+    ResolutionController c = {};
+    c.budgetMs = budgetMs;
+    c.minScale = minScale;
+    c.maxScale = std::max(minScale, maxScale);
+    c.scale = clampScale(c, scale);
+    return c;
+}
+
+bool updateResolutionController(ResolutionController& c, float gpuMs) {
+    if (gpuMs <= 0.f) return false;
+    if (c.cooldown > 0) {
+        --c.cooldown;
+        return false;
+    }
+    c.filteredMs = c.filteredMs > 0.f ? c.filteredMs * 0.75f + gpuMs * 0.25f : gpuMs;
+
+    // A sample only counts towards a change when it and the smoothed time agree, so one
+    // spike neither shrinks the scale nor interrupts a run of cheap frames.
+    float target = c.scale;
+    float headroomMs = c.budgetMs * DYNAMIC_RES_HEADROOM;
+    if (c.filteredMs > c.budgetMs && gpuMs > c.budgetMs) {
+        c.underBudget = 0;
+        if (++c.overBudget < DYNAMIC_RES_SHRINK_FRAMES) return false;
+        // Aim a little under the budget so the next frames land inside the dead band.
+        target = floorf(c.scale * sqrtf(c.budgetMs * 0.9f / c.filteredMs) / DYNAMIC_RES_STEP) * DYNAMIC_RES_STEP;
+    } else if (c.filteredMs < headroomMs && gpuMs < headroomMs) {
+        c.overBudget = 0;
+        if (++c.underBudget >= DYNAMIC_RES_GROW_FRAMES) {
+            float grow = std::min(sqrtf(c.budgetMs * 0.9f / c.filteredMs), 1.25f);
+            target = std::max(floorf(c.scale * grow / DYNAMIC_RES_STEP), roundf(c.scale / DYNAMIC_RES_STEP) + 1.f) * DYNAMIC_RES_STEP;
+        }
+    } else if (c.filteredMs <= c.budgetMs && c.filteredMs >= headroomMs) {
+        c.overBudget = c.underBudget = 0;
+    }
+
+    target = clampScale(c, target);
+    if (target == c.scale) return false;
+    c.scale = target;
+    c.filteredMs = 0.f;
+    c.overBudget = c.underBudget = 0;
+    c.cooldown = DYNAMIC_RES_COOLDOWN;
+    ++c.changes;
+    return true;
+}
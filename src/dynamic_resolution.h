@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Chooses the scene's render scale from measured GPU frame times to hold a frame budget.
+// After DYNAMIC_RES_SHRINK_FRAMES samples over budget, the scale drops in proportion to the
+// overshoot (pixel cost goes with the square of the scale). It grows again only after frames have stayed below
+// DYNAMIC_RES_HEADROOM of the budget for DYNAMIC_RES_GROW_FRAMES samples. Times between
+// the two thresholds change nothing, and each change waits DYNAMIC_RES_COOLDOWN samples so
+// the GPU timer latency has passed. Together these keep the scale from oscillating.
+
+const float DYNAMIC_RES_HEADROOM = 0.75f;
+const int DYNAMIC_RES_SHRINK_FRAMES = 3;
+const int DYNAMIC_RES_GROW_FRAMES = 30;
+const int DYNAMIC_RES_COOLDOWN = 8;
+const float DYNAMIC_RES_STEP = 1.f / 32.f;  // scales are kept on this grid
+
+struct ResolutionController {
+    float budgetMs;
+    float scale, minScale, maxScale;
+    float filteredMs;  // smoothed GPU frame time since the last change, 0 when reset
+    int cooldown;
+    int overBudget, underBudget;
+    uint32_t changes;
+};
+
+ResolutionController createResolutionController(float budgetMs, float scale, float minScale, float maxScale);
+// Feeds one GPU frame time in ms; returns true when the scale changed.
+bool updateResolutionController(ResolutionController& controller, float gpuMs);
@@ -0,0 +1,207 @@
+#include "ecs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const uint32_t componentSizes[ECS_COMPONENT_COUNT] = {
+    sizeof(Transform), sizeof(MeshRef), sizeof(MaterialRef), sizeof(Bounds),
+};
+static const uint32_t ENTITY_INDEX_BITS = 24;
+static const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+// Chunks of views handed to one job; a chunk holds a few hundred entities.
+static const uint32_t QUERY_GRAIN = 4;
+
+struct alignas(64) ChunkBlock {
+    uint8_t bytes[ECS_CHUNK_BYTES];
+};
+
+static uint32_t alignUp(uint32_t value) { return (value + 15) & ~15u; }
+
+static uint32_t chunkBytes(ComponentMask mask, uint32_t capacity) {
+    uint32_t bytes = alignUp(capacity * (uint32_t)sizeof(Entity));
+    for (int c = 0; c < ECS_COMPONENT_COUNT; ++c)
+        if (mask & (1u << c)) bytes += alignUp(capacity * componentSizes[c]);
+    return bytes;
+}
+
+static uint32_t findArchetype(EcsWorld& world, ComponentMask mask) {
+    for (uint32_t i = 0; i < world.archetypes.size(); ++i)
+        if (world.archetypes[i].mask == mask) return i;
+
+    EcsArchetype archetype = {};
+    archetype.mask = mask;
+    uint32_t rowBytes = sizeof(Entity);
+    for (int c = 0; c < ECS_COMPONENT_COUNT; ++c)
+        if (mask & (1u << c)) rowBytes += componentSizes[c];
+    archetype.capacity = ECS_CHUNK_BYTES / rowBytes;
+    while (chunkBytes(mask, archetype.capacity) > ECS_CHUNK_BYTES) --archetype.capacity;
+    // Arrays are 16-byte aligned so systems can load transforms with SSE.
+    uint32_t offset = 0;
+    for (int c = 0; c < ECS_COMPONENT_COUNT; ++c) {
+        if (!(mask & (1u << c))) continue;
+        archetype.offsets[c] = offset;
+        offset += alignUp(archetype.capacity * componentSizes[c]);
+    }
+    archetype.entityOffset = offset;
+    world.archetypes.push_back(archetype);
+    return (uint32_t)world.archetypes.size() - 1;
+}
+
+static uint32_t recordIndex(const EcsWorld& world, Entity entity) {
+    if (!entityAlive(world, entity)) throw std::runtime_error("Stale or invalid entity");
+    return entity & ENTITY_INDEX_MASK;
+}
+
+static uint8_t* componentAt(const EcsArchetype& archetype, const EcsChunk& chunk, int component, uint32_t row) {
+    return chunk.data + archetype.offsets[component] + (size_t)row * componentSizes[component];
+}
+
+static Entity& entityAt(const EcsArchetype& archetype, const EcsChunk& chunk, uint32_t row) {
+    return ((Entity*)(chunk.data + archetype.entityOffset))[row];
+}
+
+// Appends a zeroed row to the archetype's last chunk, starting a chunk when it is full.
+static void allocateRow(EcsWorld& world, uint32_t archetypeIndex, Entity entity, EcsRecord& rec) {
+    EcsArchetype& archetype = world.archetypes[archetypeIndex];
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        EcsChunk chunk = {};
+        if (!world.freeChunks.empty()) {
+            chunk.data = world.freeChunks.back();
+            world.freeChunks.pop_back();
+        } else {
+            chunk.data = (new ChunkBlock)->bytes;
+        }
+        archetype.chunks.push_back(chunk);
+    }
+    EcsChunk& chunk = archetype.chunks.back();
+    uint32_t row = chunk.count++;
+    for (int c = 0; c < ECS_COMPONENT_COUNT; ++c)
+        if (archetype.mask & (1u << c)) memset(componentAt(archetype, chunk, c, row), 0, componentSizes[c]);
+    entityAt(archetype, chunk, row) = entity;
+    rec.archetype = archetypeIndex;
+    rec.chunk = (uint32_t)archetype.chunks.size() - 1;
+    rec.row = row;
+}
+
+// Fills the hole with the archetype's last entity so the chunks stay packed.
+static void releaseRow(EcsWorld& world, uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row) {
+    EcsArchetype& archetype = world.archetypes[archetypeIndex];
+    EcsChunk& last = archetype.chunks.back();
+    uint32_t lastRow = last.count - 1;
+    EcsChunk& chunk = archetype.chunks[chunkIndex];
+    if (&chunk != &last || row != lastRow) {
+        for (int c = 0; c < ECS_COMPONENT_COUNT; ++c)
+            if (archetype.mask & (1u << c))
+                memcpy(componentAt(archetype, chunk, c, row), componentAt(archetype, last, c, lastRow), componentSizes[c]);
+        Entity moved = entityAt(archetype, last, lastRow);
+        entityAt(archetype, chunk, row) = moved;
+        EcsRecord& movedRecord = world.records[moved & ENTITY_INDEX_MASK];
+        movedRecord.chunk = chunkIndex;
+        movedRecord.row = row;
+    }
+    if (--last.count == 0) {
+        world.freeChunks.push_back(last.data);
+        archetype.chunks.pop_back();
+    }
+}
+
+EcsWorld createEcsWorld() {
+    return EcsWorld{};
+}
+
+void freeEcsWorld(EcsWorld& world) {
+    for (EcsArchetype& archetype : world.archetypes)
+        for (EcsChunk& chunk : archetype.chunks) world.freeChunks.push_back(chunk.data);
+    for (uint8_t* data : world.freeChunks) delete (ChunkBlock*)data;
+    world = EcsWorld{};
+}
+
+Entity createEntity(EcsWorld& world, ComponentMask components) {
+    uint32_t index;
+    if (!world.freeRecords.empty()) {
+        index = world.freeRecords.back();
+        world.freeRecords.pop_back();
+    } else {
+        if (world.records.size() > ENTITY_INDEX_MASK) throw std::runtime_error("Too many entities");
+        index = (uint32_t)world.records.size();
+        world.records.push_back(EcsRecord{});
+    }
+    EcsRecord& rec = world.records[index];
+    rec.alive = true;
+    Entity entity = index | (uint32_t)rec.generation << ENTITY_INDEX_BITS;
+    allocateRow(world, findArchetype(world, components), entity, rec);
+    return entity;
+}
+
+void destroyEntity(EcsWorld& world, Entity entity) {
+    EcsRecord& rec = world.records[recordIndex(world, entity)];
+    releaseRow(world, rec.archetype, rec.chunk, rec.row);
+    rec.alive = false;
+    ++rec.generation;
+    world.freeRecords.push_back(entity & ENTITY_INDEX_MASK);
+}
+
+bool entityAlive(const EcsWorld& world, Entity entity) {
+    uint32_t index = entity & ENTITY_INDEX_MASK;
+    return entity != NO_ENTITY && index < world.records.size() && world.records[index].alive &&
+           world.records[index].generation == (uint8_t)(entity >> ENTITY_INDEX_BITS);
+}
+
+static void moveEntity(EcsWorld& world, Entity entity, ComponentMask mask) {
+    EcsRecord& rec = world.records[recordIndex(world, entity)];
+    if (world.archetypes[rec.archetype].mask == mask) return;
+    EcsRecord old = rec;
+    uint32_t target = findArchetype(world, mask);  // may grow the archetype list
+    allocateRow(world, target, entity, rec);
+    const EcsArchetype& from = world.archetypes[old.archetype];
+    const EcsArchetype& to = world.archetypes[target];
+    for (int c = 0; c < ECS_COMPONENT_COUNT; ++c)
+        if (from.mask & to.mask & (1u << c))
+            memcpy(componentAt(to, to.chunks[rec.chunk], c, rec.row), componentAt(from, from.chunks[old.chunk], c, old.row), componentSizes[c]);
+    releaseRow(world, old.archetype, old.chunk, old.row);
+}
+
+void addComponents(EcsWorld& world, Entity entity, ComponentMask components) {
+    moveEntity(world, entity, entityComponents(world, entity) | components);
+}
+
+void removeComponents(EcsWorld& world, Entity entity, ComponentMask components) {
+    moveEntity(world, entity, entityComponents(world, entity) & ~components);
+}
+
+ComponentMask entityComponents(const EcsWorld& world, Entity entity) {
+    return world.archetypes[world.records[recordIndex(world, entity)].archetype].mask;
+}
+
+void* entityComponent(EcsWorld& world, Entity entity, EcsComponent component) {
+    const EcsRecord& rec = world.records[recordIndex(world, entity)];
+    const EcsArchetype& archetype = world.archetypes[rec.archetype];
+    if (!(archetype.mask & componentBit(component))) return nullptr;
+    return componentAt(archetype, archetype.chunks[rec.chunk], component, rec.row);
+}
+
+void runEcsQuery(const EcsWorld& world, ComponentMask all, EcsQuery& query) {
+    query.views.clear();
+    query.count = 0;
+    for (const EcsArchetype& archetype : world.archetypes) {
+        if ((archetype.mask & all) != all) continue;
+        for (const EcsChunk& chunk : archetype.chunks) {
+            query.views.push_back({ chunk.data, &archetype, chunk.count, query.count });
+            query.count += chunk.count;
+        }
+    }
+}
+
+void locateQueryRow(const EcsQuery& query, uint32_t index, uint32_t* view, uint32_t* row) {
+    auto next = std::upper_bound(query.views.begin(), query.views.end(), index,
+                                 [](uint32_t i, const EcsView& v) { return i < v.first; });
+    *view = (uint32_t)(next - query.views.begin()) - 1;
+    *row = index - query.views[*view].first;
+}
+
+void parallelForQuery(JobPool* pool, const EcsQuery& query, const std::function<void(const EcsView& view)>& job) {
+    parallelFor(pool, (uint32_t)query.views.size(), QUERY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) job(query.views[i]);
+    });
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "job_pool.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Entities grouped by archetype, the exact set of components they have. Each archetype
+// stores its entities in fixed-size chunks holding one packed array per component, so a
+// query walks a list of chunks and hands each system plain arrays. Removing an entity moves
+// the last one of its archetype into the hole, and emptied chunks go to a free list that
+// every archetype allocates from, so adding and removing components reuses memory.
+
+enum EcsComponent {
+    ECS_TRANSFORM,
+    ECS_MESH,
+    ECS_MATERIAL,
+    ECS_BOUNDS,
+    ECS_COMPONENT_COUNT
+};
+
+typedef uint32_t ComponentMask;
+inline ComponentMask componentBit(EcsComponent component) { return 1u << component; }
+
+struct Transform {
+    float model[16];
+};
+
+struct MeshRef {
+    uint32_t mesh;  // index into the caller's mesh table
+};
+
+struct MaterialRef {
+    uint32_t textureSlot;
+};
+
+// World-space bounding sphere.
+struct Bounds {
+    float center[3];
+    float radius;
+};
+
+// Low 24 bits index the entity table, high 8 bits are a generation that catches stale handles.
+typedef uint32_t Entity;
+const Entity NO_ENTITY = 0xFFFFFFFFu;
+
+const uint32_t ECS_CHUNK_BYTES = 16 * 1024;
+
+struct EcsChunk {
+    uint8_t* data;
+    uint32_t count;
+};
+
+struct EcsArchetype {
+    ComponentMask mask;
+    uint32_t capacity;  // entities per chunk
+    uint32_t offsets[ECS_COMPONENT_COUNT];  // array start within a chunk, for components in mask
+    uint32_t entityOffset;
+    std::vector<EcsChunk> chunks;  // all full except the last
+};
+
+struct EcsRecord {
+    uint32_t archetype, chunk, row;
+    uint8_t generation;
+    bool alive;
+};
+
+struct EcsWorld {
+    std::vector<EcsArchetype> archetypes;
+    std::vector<EcsRecord> records;  // indexed by entity
+    std::vector<uint32_t> freeRecords;
+    std::vector<uint8_t*> freeChunks;
+};
+
+// One chunk of a query result. first is the index of its first entity across the whole
+// query, so results can be written to flat arrays.
+struct EcsView {
+    uint8_t* data;
+    const EcsArchetype* archetype;
+    uint32_t count;
+    uint32_t first;
+};
+
+struct EcsQuery {
+    std::vector<EcsView> views;
+    uint32_t count;
+};
+
+EcsWorld createEcsWorld();
+void freeEcsWorld(EcsWorld& world);
+// The new entity's components are zeroed.
+Entity createEntity(EcsWorld& world, ComponentMask components);
+void destroyEntity(EcsWorld& world, Entity entity);
+bool entityAlive(const EcsWorld& world, Entity entity);
+// Both move the entity to the archetype of its new component set, keeping the values of
+// the components it still has. Added components are zeroed.
+void addComponents(EcsWorld& world, Entity entity, ComponentMask components);
+void removeComponents(EcsWorld& world, Entity entity, ComponentMask components);
+ComponentMask entityComponents(const EcsWorld& world, Entity entity);
+// nullptr when the entity lacks the component. Pointers move when entities are added,
+// removed or change archetype.
+void* entityComponent(EcsWorld& world, Entity entity, EcsComponent component);
+
+// Collects the chunks of every archetype that has all of the given components. The views
+// stay valid until the world changes.
+void runEcsQuery(const EcsWorld& world, ComponentMask all, EcsQuery& query);
+inline void* ecsArray(const EcsView& view, EcsComponent component) { return view.data + view.archetype->offsets[component]; }
+inline const Entity* ecsEntities(const EcsView& view) { return (const Entity*)(view.data + view.archetype->entityOffset); }
+// Finds the view and row of the index-th entity of a query.
+void locateQueryRow(const EcsQuery& query, uint32_t index, uint32_t* view, uint32_t* row);
+// Runs job on every view, spreading them over the pool.
+void parallelForQuery(JobPool* pool, const EcsQuery& query, const std::function<void(const EcsView& view)>& job);
@@ -0,0 +1,166 @@
+#include "frame_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+void clearFrameGraph(FrameGraph& graph) {
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.order.clear();
+    graph.physical.clear();
+}
+
+static uint32_t addResource(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc, bool imported, uint32_t external) {
+    FrameGraphResource resource = {};
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = imported;
+    resource.external = external;
+    resource.physical = FRAME_GRAPH_NONE;
+    graph.resources.push_back(resource);
+    return (uint32_t)graph.resources.size() - 1;
+}
+
+uint32_t createFrameGraphTexture(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc) {
+    return addResource(graph, name, desc, false, 0);
+}
+
+uint32_t importFrameGraphTarget(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc, uint32_t external) {
+    return addResource(graph, name, desc, true, external);
+}
+
+uint32_t addFrameGraphPass(FrameGraph& graph, const char* name, const std::vector<uint32_t>& reads,
+                           const std::vector<uint32_t>& writes, std::function<void()> execute) {
+    uint32_t index = (uint32_t)graph.passes.size();
+    graph.passes.push_back({ name, reads, writes, std::move(execute), false });
+    for (uint32_t resource : writes) graph.resources[resource].writers.push_back(index);
+    return index;
+}
+
+static bool contains(const std::vector<uint32_t>& list, uint32_t value) {
+    return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+void compileFrameGraph(FrameGraph& graph) {
+    size_t passCount = graph.passes.size();
+    std::vector<std::vector<uint32_t>> dependencies(passCount);  // passes each pass must follow
+    for (uint32_t p = 0; p < passCount; ++p) {
+        const FrameGraphPass& pass = graph.passes[p];
+        for (uint32_t r : pass.writes) {
+            const std::vector<uint32_t>& writers = graph.resources[r].writers;
+            size_t position = std::find(writers.begin(), writers.end(), p) - writers.begin();
+            if (position > 0) dependencies[p].push_back(writers[position - 1]);
+        }
+        for (uint32_t r : pass.reads) {
+            const FrameGraphResource& resource = graph.resources[r];
+            if (contains(pass.writes, r)) continue;
+            if (!resource.writers.empty()) dependencies[p].push_back(resource.writers.back());
+            else if (!resource.imported) throw std::runtime_error("Frame graph pass " + pass.name + " reads " + resource.name + ", which no pass writes");
+        }
+    }
+
+    // Outputs and side-effect passes are needed, and so is everything they depend on.
+    std::vector<uint32_t> stack;
+    for (uint32_t p = 0; p < passCount; ++p) {
+        FrameGraphPass& pass = graph.passes[p];
+        pass.culled = true;
+        bool output = pass.writes.empty();
+        for (uint32_t r : pass.writes) output |= graph.resources[r].imported;
+        if (output) stack.push_back(p);
+    }
+    while (!stack.empty()) {
+        uint32_t p = stack.back();
+        stack.pop_back();
+        if (!graph.passes[p].culled) continue;
+        graph.passes[p].culled = false;
+        for (uint32_t d : dependencies[p]) stack.push_back(d);
+    }
+
+    // Kahn's algorithm, taking the earliest declared ready pass, so independent passes
+    // keep the order they were added in.
+    std::vector<uint32_t> waiting(passCount, 0);
+    std::vector<std::vector<uint32_t>> dependents(passCount);
+    for (uint32_t p = 0; p < passCount; ++p) {
+        if (graph.passes[p].culled) continue;
+        for (uint32_t d : dependencies[p]) {
+            dependents[d].push_back(p);
+            ++waiting[p];
+        }
+    }
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+    size_t keptCount = 0;
+    for (uint32_t p = 0; p < passCount; ++p) {
+        if (graph.passes[p].culled) continue;
+        ++keptCount;
+        if (!waiting[p]) ready.push(p);
+    }
+    graph.order.clear();
+    while (!ready.empty()) {
+        uint32_t p = ready.top();
+        ready.pop();
+        graph.order.push_back(p);
+        for (uint32_t next : dependents[p])
+            if (--waiting[next] == 0) ready.push(next);
+    }
+    if (graph.order.size() != keptCount) throw std::runtime_error("Frame graph has a dependency cycle");
+
+    for (FrameGraphResource& resource : graph.resources) {
+        resource.firstUse = FRAME_GRAPH_NONE;
+        resource.lastUse = 0;
+        resource.physical = FRAME_GRAPH_NONE;
+    }
+    for (uint32_t position = 0; position < graph.order.size(); ++position) {
+        const FrameGraphPass& pass = graph.passes[graph.order[position]];
+        for (const std::vector<uint32_t>* list : { &pass.reads, &pass.writes }) {
+            for (uint32_t r : *list) {
+                FrameGraphResource& resource = graph.resources[r];
+                resource.firstUse = std::min(resource.firstUse, position);
+                resource.lastUse = std::max(resource.lastUse, position);
+            }
+        }
+    }
+
+    // Greedy interval assignment: in order of first use, each transient takes a free slot
+    // with the same description, or a new one.
+    std::vector<uint32_t> transients;
+    for (uint32_t r = 0; r < graph.resources.size(); ++r)
+        if (!graph.resources[r].imported && graph.resources[r].firstUse != FRAME_GRAPH_NONE) transients.push_back(r);
+    std::stable_sort(transients.begin(), transients.end(),
+                     [&](uint32_t a, uint32_t b) { return graph.resources[a].firstUse < graph.resources[b].firstUse; });
+    graph.physical.clear();
+    std::vector<uint32_t> busyUntil;
+    for (uint32_t r : transients) {
+        FrameGraphResource& resource = graph.resources[r];
+        for (uint32_t slot = 0; slot < graph.physical.size() && resource.physical == FRAME_GRAPH_NONE; ++slot) {
+            const FrameGraphTextureDesc& desc = graph.physical[slot];
+            if (busyUntil[slot] < resource.firstUse && desc.width == resource.desc.width &&
+                desc.height == resource.desc.height && desc.format == resource.desc.format)
+                resource.physical = slot;
+        }
+        if (resource.physical == FRAME_GRAPH_NONE) {
+            resource.physical = (uint32_t)graph.physical.size();
+            graph.physical.push_back(resource.desc);
+            busyUntil.push_back(0);
+        }
+        busyUntil[resource.physical] = resource.lastUse;
+    }
+}
+
+size_t frameGraphFormatBytes(FrameGraphFormat format) {
+    switch (format) {
+    case FRAME_GRAPH_RGBA16F: return 8;
+    default: return 4;
+    }
+}
+
+FrameGraphMemory frameGraphMemory(const FrameGraph& graph) {
+    FrameGraphMemory memory = {};
+    for (const FrameGraphResource& resource : graph.resources)
+        if (resource.physical != FRAME_GRAPH_NONE)
+            memory.transientBytes += (size_t)resource.desc.width * resource.desc.height * frameGraphFormatBytes(resource.desc.format);
+    for (const FrameGraphTextureDesc& desc : graph.physical)
+        memory.physicalBytes += (size_t)desc.width * desc.height * frameGraphFormatBytes(desc.format);
+    return memory;
+}
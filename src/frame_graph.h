@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Passes declare the textures they read and write; compileFrameGraph drops passes whose
+// results reach no output, orders the rest so each runs after the writers of what it
+// reads, and gives transient textures physical slots, sharing a slot between textures
+// whose lifetimes do not overlap. GL cannot place different formats in the same memory,
+// so only textures with identical descriptions share. Compiling makes no GL calls;
+// frame_graph_gl creates the textures and framebuffers and runs the passes.
+
+enum FrameGraphFormat { FRAME_GRAPH_RGBA8, FRAME_GRAPH_RGBA16F, FRAME_GRAPH_DEPTH24 };
+
+struct FrameGraphTextureDesc {
+    int width, height;
+    FrameGraphFormat format;
+};
+
+const uint32_t FRAME_GRAPH_NONE = 0xFFFFFFFFu;
+
+struct FrameGraphResource {
+    std::string name;
+    FrameGraphTextureDesc desc;
+    bool imported;                  // owned by the caller and outlives the frame, like the window
+    uint32_t external;              // the caller's handle for an imported resource
+    std::vector<uint32_t> writers;  // passes, in declaration order
+    uint32_t firstUse, lastUse;     // positions in the compiled order
+    uint32_t physical;              // transient slot, FRAME_GRAPH_NONE when no pass that runs uses it
+};
+
+struct FrameGraphPass {
+    std::string name;
+    std::vector<uint32_t> reads, writes;
+    std::function<void()> execute;
+    bool culled;
+};
+
+struct FrameGraph {
+    std::vector<FrameGraphResource> resources;
+    std::vector<FrameGraphPass> passes;
+    std::vector<uint32_t> order;                  // passes that run, in order
+    std::vector<FrameGraphTextureDesc> physical;  // one per physical texture
+};
+
+struct FrameGraphMemory {
+    size_t transientBytes;  // every used transient texture on its own
+    size_t physicalBytes;   // after aliasing
+};
+
+void clearFrameGraph(FrameGraph& graph);
+uint32_t createFrameGraphTexture(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc);
+// Passes writing an imported target are outputs and are never culled.
+uint32_t importFrameGraphTarget(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc, uint32_t external);
+// Written resources become the pass's attachments. A pass that reads a resource it also
+// writes continues the work of the writers declared before it; any other reader sees the
+// result of every writer. A pass that writes nothing is kept for its side effects.
+uint32_t addFrameGraphPass(FrameGraph& graph, const char* name, const std::vector<uint32_t>& reads,
+                           const std::vector<uint32_t>& writes, std::function<void()> execute = {});
+// Throws on a dependency cycle or on a read of a transient texture no pass writes.
+void compileFrameGraph(FrameGraph& graph);
+FrameGraphMemory frameGraphMemory(const FrameGraph& graph);
+size_t frameGraphFormatBytes(FrameGraphFormat format);
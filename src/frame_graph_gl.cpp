@@ -0,0 +1,114 @@
+#include "frame_graph_gl.h"
+
+#include "gl_state.h"
+
+#include <stdexcept>
+
+static GLuint createTexture(const FrameGraphTextureDesc& desc) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    cachedBindTexture(0, GL_TEXTURE_2D, texture);
+    bool depth = desc.format == FRAME_GRAPH_DEPTH24;
+    if (depth)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, desc.width, desc.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    else if (desc.format == FRAME_GRAPH_RGBA16F)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, desc.width, desc.height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, desc.width, desc.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static void clearFramebuffers(FrameGraphTargets& targets) {
+    for (auto& entry : targets.framebuffers) glDeleteFramebuffers(1, &entry.second);
+    targets.framebuffers.clear();
+}
+
+static GLuint passFramebuffer(const FrameGraph& graph, FrameGraphTargets& targets, const FrameGraphPass& pass) {
+    std::vector<GLuint> attachments;
+    for (uint32_t r : pass.writes) {
+        const FrameGraphResource& resource = graph.resources[r];
+        if (resource.imported) return resource.external;
+        attachments.push_back(targets.textures[resource.physical]);
+    }
+    auto found = targets.framebuffers.find(attachments);
+    if (found != targets.framebuffers.end()) return found->second;
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    std::vector<GLenum> drawBuffers;
+    for (size_t i = 0; i < pass.writes.size(); ++i) {
+        if (graph.resources[pass.writes[i]].desc.format == FRAME_GRAPH_DEPTH24) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attachments[i], 0);
+        } else {
+            GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[i], 0);
+            drawBuffers.push_back(attachment);
+        }
+    }
+    if (drawBuffers.empty()) glDrawBuffer(GL_NONE);
+    else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Frame graph pass " + pass.name + " has an incomplete framebuffer");
+    targets.framebuffers[attachments] = fbo;
+    return fbo;
+}
+
+void executeFrameGraph(const FrameGraph& graph, FrameGraphTargets& targets) {
+    bool changed = targets.textures.size() != graph.physical.size();
+    for (size_t slot = 0; slot < graph.physical.size(); ++slot) {
+        const FrameGraphTextureDesc& desc = graph.physical[slot];
+        if (slot < targets.textures.size()) {
+            const FrameGraphTextureDesc& old = targets.descs[slot];
+            if (old.width == desc.width && old.height == desc.height && old.format == desc.format) continue;
+            cachedDeleteTextures(1, &targets.textures[slot]);
+            targets.textures[slot] = createTexture(desc);
+            targets.descs[slot] = desc;
+        } else {
+            targets.textures.push_back(createTexture(desc));
+            targets.descs.push_back(desc);
+        }
+        changed = true;
+    }
+    if (targets.textures.size() > graph.physical.size()) {
+        cachedDeleteTextures((GLsizei)(targets.textures.size() - graph.physical.size()), &targets.textures[graph.physical.size()]);
+        targets.textures.resize(graph.physical.size());
+        targets.descs.resize(graph.physical.size());
+    }
+    if (changed) clearFramebuffers(targets);
+
+    targets.passFramebuffers.assign(graph.passes.size(), 0);
+    for (uint32_t p : graph.order) {
+        const FrameGraphPass& pass = graph.passes[p];
+        // Side-effect passes have no attachments and keep whatever is bound.
+        if (!pass.writes.empty()) {
+            GLuint fbo = passFramebuffer(graph, targets, pass);
+            targets.passFramebuffers[p] = fbo;
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            if (!graph.resources[pass.writes[0]].imported) {
+                const FrameGraphTextureDesc& desc = graph.resources[pass.writes[0]].desc;
+                glViewport(0, 0, desc.width, desc.height);
+            }
+        }
+        if (pass.execute) pass.execute();
+    }
+}
+
+void freeFrameGraphTargets(FrameGraphTargets& targets) {
+    clearFramebuffers(targets);
+    if (!targets.textures.empty()) cachedDeleteTextures((GLsizei)targets.textures.size(), targets.textures.data());
+    targets = {};
+}
+
+GLuint frameGraphTexture(const FrameGraph& graph, const FrameGraphTargets& targets, uint32_t resource) {
+    uint32_t slot = graph.resources[resource].physical;
+    return slot == FRAME_GRAPH_NONE ? 0 : targets.textures[slot];
+}
+
+GLuint frameGraphFramebuffer(const FrameGraphTargets& targets, uint32_t pass) {
+    return targets.passFramebuffers[pass];
+}
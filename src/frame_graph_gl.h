@@ -0,0 +1,26 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "frame_graph.h"
+
+#include <map>
+#include <vector>
+
+// Runs a compiled frame graph on GL. Each physical slot is one texture, kept from frame
+// to frame while its description stays the same, and each distinct set of attachments
+// gets one framebuffer.
+
+struct FrameGraphTargets {
+    std::vector<GLuint> textures;  // by physical slot
+    std::vector<FrameGraphTextureDesc> descs;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;
+    std::vector<GLuint> passFramebuffers;  // by pass, for the last executed frame
+};
+
+// Binds each pass's framebuffer and calls it. Transient attachments also set the viewport
+// to their size. A pass writing an imported target, such as the window, draws into the
+// target's own framebuffer and keeps the current viewport.
+void executeFrameGraph(const FrameGraph& graph, FrameGraphTargets& targets);
+void freeFrameGraphTargets(FrameGraphTargets& targets);
+GLuint frameGraphTexture(const FrameGraph& graph, const FrameGraphTargets& targets, uint32_t resource);
+GLuint frameGraphFramebuffer(const FrameGraphTargets& targets, uint32_t pass);
@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Bounded queue of frame packets between one producer (simulation) and one consumer
+// (render) thread. The packets live in a fixed ring of slots that are reused every lap,
+// so nothing is allocated per frame: the producer fills the next free slot and publishes
+// it, the consumer reads the oldest published slot and releases it when done. With two
+// slots the threads overlap by one frame; a third lets the producer run a further frame
+// ahead. The producer blocks when every slot is taken, which bounds the latency.
+
+template<typename T>
+struct FrameQueue {
+    std::vector<T> slots;
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t first;  // oldest slot held by the consumer or waiting for it
+    uint32_t ready;  // published slots not yet acquired
+    bool reading;  // the consumer holds slot first
+    bool closed;
+};
+
+template<typename T>
+void initFrameQueue(FrameQueue<T>& queue, uint32_t slots) {
+    queue.slots.resize(slots < 2 ? 2 : slots);
+    queue.first = queue.ready = 0;
+    queue.reading = queue.closed = false;
+}
+
+// Waits for a free slot; nullptr once the queue is closed.
+template<typename T>
+T* beginFramePacket(FrameQueue<T>& queue) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    uint32_t capacity = (uint32_t)queue.slots.size();
+    queue.changed.wait(lock, [&] { return queue.closed || queue.ready + queue.reading < capacity; });
+    if (queue.closed) return nullptr;
+    return &queue.slots[(queue.first + queue.reading + queue.ready) % capacity];
+}
+
+template<typename T>
+void publishFramePacket(FrameQueue<T>& queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    ++queue.ready;
+    queue.changed.notify_all();
+}
+
+// Waits for the oldest published packet; nullptr once the queue is closed and drained.
+template<typename T>
+T* acquireFramePacket(FrameQueue<T>& queue) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.changed.wait(lock, [&] { return queue.closed || queue.ready > 0; });
+    if (queue.ready == 0) return nullptr;
+    --queue.ready;
+    queue.reading = true;
+    return &queue.slots[queue.first];
+}
+
+template<typename T>
+void releaseFramePacket(FrameQueue<T>& queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.first = (queue.first + 1) % (uint32_t)queue.slots.size();
+    queue.reading = false;
+    queue.changed.notify_all();
+}
+
+// Wakes both sides; the consumer still drains the packets already published.
+template<typename T>
+void closeFrameQueue(FrameQueue<T>& queue) {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.closed = true;
+    queue.changed.notify_all();
+}
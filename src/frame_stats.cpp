@@ -0,0 +1,29 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static double percentile(const std::vector<float>& sorted, double p) {
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+TimeStats summarizeTimes(std::vector<float> samplesMs) {
+    TimeStats s = { (uint32_t)samplesMs.size(), 0.0, 0.0, 0.0, 0.0, 0.0 };
+    if (samplesMs.empty()) return s;
+    std::sort(samplesMs.begin(), samplesMs.end());
+    for (float ms : samplesMs) s.meanMs += ms;
+    s.meanMs /= samplesMs.size();
+    s.p50Ms = percentile(samplesMs, 0.50);
+    s.p95Ms = percentile(samplesMs, 0.95);
+    s.p99Ms = percentile(samplesMs, 0.99);
+    s.maxMs = samplesMs.back();
+    return s;
+}
+
+std::string timeStatsJson(const TimeStats& s) {
+    char json[256];
+    snprintf(json, sizeof(json), "{ \"samples\": %u, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f }",
+             s.samples, s.meanMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs);
+    return json;
+}
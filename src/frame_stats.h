@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Summary of a set of timings in milliseconds, shared by the GPU timers and the benchmark run.
+
+struct TimeStats {
+    uint32_t samples;
+    double meanMs, p50Ms, p95Ms, p99Ms, maxMs;
+};
+
+TimeStats summarizeTimes(std::vector<float> samplesMs);
+// { "samples": n, "mean_ms": ..., "p50_ms": ..., "p95_ms": ..., "p99_ms": ..., "max_ms": ... }
+std::string timeStatsJson(const TimeStats& stats);
@@ -0,0 +1,39 @@
+#include "gl_ext.h"
+
+#include <cstring>
+
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect = nullptr;
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = nullptr;
+
+GLExtensions GLExt = {};
+
+bool hasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i), name) == 0) return true;
+    return false;
+}
+
+static bool versionAtLeast(int major, int minor) {
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+void loadGLExtensions(GLADloadproc load) {
+    glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    GLExt.bufferStorage = glad_glBufferStorage && (versionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage"));
+
+    glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+    GLExt.multiDrawIndirect = glad_glMultiDrawElementsIndirect && (versionAtLeast(4, 3) ||
+        (hasGLExtension("GL_ARB_multi_draw_indirect") && hasGLExtension("GL_ARB_base_instance")));
+
+    glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    GLint formats = 0;
+    if (versionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    GLExt.programBinary = glad_glGetProgramBinary && glad_glProgramBinary && glad_glProgramParameteri && formats > 0;
+}
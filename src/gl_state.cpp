@@ -0,0 +1,174 @@
+#include "gl_state.h"
+
+#include "gl_ext.h"
+
+#include <cstring>
+
+static const GLuint UNKNOWN = 0xFFFFFFFFu;
+static const GLenum BUFFER_TARGETS[GL_STATE_BUFFER_TARGETS] = {
+    GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+    GL_TEXTURE_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, 0x90D2 /* GL_SHADER_STORAGE_BUFFER */
+};
+
+GLStateCache GLState;
+static bool initialized = false;
+
+static bool changed(bool differs) {
+    if (differs) ++GLState.issued; else ++GLState.filtered;
+    return differs;
+}
+
+void invalidateGLStateCache() {
+    uint64_t issued = GLState.issued, filtered = GLState.filtered;
+    memset(&GLState, 0xFF, sizeof(GLState));
+    GLState.depthTest = GLState.blend = GLState.cullFace = GLState.depthMask = GLState.colorMask = -1;
+    GLState.clearColorKnown = false;
+    GLState.issued = initialized ? issued : 0;
+    GLState.filtered = initialized ? filtered : 0;
+    initialized = true;
+}
+
+void resetGLStateCounters() {
+    if (!initialized) invalidateGLStateCache();
+    GLState.issued = GLState.filtered = 0;
+}
+
+static void ensureInitialized() {
+    if (!initialized) invalidateGLStateCache();
+}
+
+void cachedUseProgram(GLuint program) {
+    ensureInitialized();
+    if (changed(GLState.program != program)) { glUseProgram(program); GLState.program = program; }
+}
+
+void cachedBindVertexArray(GLuint vao) {
+    ensureInitialized();
+    if (changed(GLState.vao != vao)) { glBindVertexArray(vao); GLState.vao = vao; }
+}
+
+static int bufferSlot(GLenum target) {
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; ++i)
+        if (BUFFER_TARGETS[i] == target) return i;
+    return -1;
+}
+
+void cachedBindBuffer(GLenum target, GLuint buffer) {
+    ensureInitialized();
+    int slot = bufferSlot(target);
+    if (slot < 0) { ++GLState.issued; glBindBuffer(target, buffer); return; }
+    if (changed(GLState.buffers[slot] != buffer)) { glBindBuffer(target, buffer); GLState.buffers[slot] = buffer; }
+}
+
+void cachedBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    ensureInitialized();
+    int slot = bufferSlot(target);
+    if (target != GL_UNIFORM_BUFFER || index >= (GLuint)GL_STATE_UNIFORM_BINDINGS) {
+        ++GLState.issued;
+        glBindBufferRange(target, index, buffer, offset, size);
+        if (slot >= 0) GLState.buffers[slot] = buffer;
+        return;
+    }
+    GLBufferRange& range = GLState.uniformRanges[index];
+    if (changed(range.buffer != buffer || range.offset != offset || range.size != size)) {
+        glBindBufferRange(target, index, buffer, offset, size);
+        range = { buffer, offset, size };
+        GLState.buffers[slot] = buffer;  // indexed binds also set the generic binding point
+    }
+}
+
+void cachedBindTexture(GLuint unit, GLenum target, GLuint texture) {
+    ensureInitialized();
+    int slot = target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_BUFFER ? 1 : -1;
+    bool known = unit < (GLuint)GL_STATE_TEXTURE_UNITS && slot >= 0;
+    if (known && !changed(GLState.textures[unit][slot] != texture)) return;
+    if (!known) ++GLState.issued;
+    if (changed(GLState.activeUnit != unit)) { glActiveTexture(GL_TEXTURE0 + unit); GLState.activeUnit = unit; }
+    glBindTexture(target, texture);
+    if (known) GLState.textures[unit][slot] = texture;
+}
+
+void cachedEnable(GLenum cap, bool enabled) {
+    ensureInitialized();
+    int* state = cap == GL_DEPTH_TEST ? &GLState.depthTest : cap == GL_BLEND ? &GLState.blend : cap == GL_CULL_FACE ? &GLState.cullFace : nullptr;
+    if (state && !changed(*state != (int)enabled)) return;
+    if (!state) ++GLState.issued;
+    if (enabled) glEnable(cap); else glDisable(cap);
+    if (state) *state = enabled;
+}
+
+void cachedDepthFunc(GLenum func) {
+    ensureInitialized();
+    if (changed(GLState.depthFunc != func)) { glDepthFunc(func); GLState.depthFunc = func; }
+}
+
+void cachedDepthMask(bool write) {
+    ensureInitialized();
+    if (changed(GLState.depthMask != (int)write)) { glDepthMask(write ? GL_TRUE : GL_FALSE); GLState.depthMask = write; }
+}
+
+void cachedColorMask(bool write) {
+    ensureInitialized();
+    if (changed(GLState.colorMask != (int)write)) {
+        GLboolean b = write ? GL_TRUE : GL_FALSE;
+        glColorMask(b, b, b, b);
+        GLState.colorMask = write;
+    }
+}
+
+void cachedBlendFunc(GLenum src, GLenum dst) {
+    ensureInitialized();
+    if (changed(GLState.blendSrc != src || GLState.blendDst != dst)) {
+        glBlendFunc(src, dst);
+        GLState.blendSrc = src; GLState.blendDst = dst;
+    }
+}
+
+void cachedCullFace(GLenum mode) {
+    ensureInitialized();
+    if (changed(GLState.cullMode != mode)) { glCullFace(mode); GLState.cullMode = mode; }
+}
+
+void cachedClearColor(float r, float g, float b, float a) {
+    ensureInitialized();
+    const float color[4] = { r, g, b, a };
+    if (changed(!GLState.clearColorKnown || memcmp(GLState.clearColor, color, sizeof(color)) != 0)) {
+        glClearColor(r, g, b, a);
+        memcpy(GLState.clearColor, color, sizeof(color));
+        GLState.clearColorKnown = true;
+    }
+}
+
+void cachedDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    ensureInitialized();
+    for (GLsizei i = 0; i < n; ++i) {
+        for (GLuint& bound : GLState.buffers)
+            if (bound == buffers[i]) bound = 0;
+        for (GLBufferRange& range : GLState.uniformRanges)
+            if (range.buffer == buffers[i]) range = { 0, 0, 0 };
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void cachedDeleteVertexArrays(GLsizei n, const GLuint* vaos) {
+    ensureInitialized();
+    for (GLsizei i = 0; i < n; ++i)
+        if (GLState.vao == vaos[i]) GLState.vao = 0;
+    glDeleteVertexArrays(n, vaos);
+}
+
+void cachedDeleteTextures(GLsizei n, const GLuint* textures) {
+    ensureInitialized();
+    for (GLsizei i = 0; i < n; ++i)
+        for (auto& unit : GLState.textures)
+            for (GLuint& bound : unit)
+                if (bound == textures[i]) bound = 0;
+    glDeleteTextures(n, textures);
+}
+
+void cachedDeleteProgram(GLuint program) {
+    ensureInitialized();
+    // A deleted program stays current until something else is bound, so its name is not free yet.
+    if (GLState.program == program) GLState.program = UNKNOWN;
+    glDeleteProgram(program);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Shadow copy of the GL state the renderer touches. The cached* calls forward to GL only
+// when the value actually changes and count how many calls were issued or filtered out.
+// Everything in the viewer binds through these, so the shadow never goes stale; code that
+// changes state behind the cache's back must call invalidateGLStateCache afterwards.
+// GL_ELEMENT_ARRAY_BUFFER belongs to the VAO and is always forwarded.
+
+const int GL_STATE_TEXTURE_UNITS = 16;
+const int GL_STATE_UNIFORM_BINDINGS = 16;
+const int GL_STATE_BUFFER_TARGETS = 9;
+
+struct GLBufferRange {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+struct GLStateCache {
+    GLuint program, vao;
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][2];  // GL_TEXTURE_2D, GL_TEXTURE_BUFFER
+    GLuint buffers[GL_STATE_BUFFER_TARGETS];
+    GLBufferRange uniformRanges[GL_STATE_UNIFORM_BINDINGS];
+    int depthTest, blend, cullFace;  // -1 unknown, 0 disabled, 1 enabled
+    GLenum depthFunc, blendSrc, blendDst, cullMode;
+    int depthMask, colorMask;
+    float clearColor[4];
+    bool clearColorKnown;
+    uint64_t issued, filtered;
+};
+extern GLStateCache GLState;
+
+void invalidateGLStateCache();
+void resetGLStateCounters();
+
+void cachedUseProgram(GLuint program);
+void cachedBindVertexArray(GLuint vao);
+void cachedBindBuffer(GLenum target, GLuint buffer);
+void cachedBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void cachedBindTexture(GLuint unit, GLenum target, GLuint texture);
+void cachedEnable(GLenum cap, bool enabled);
+void cachedDepthFunc(GLenum func);
+void cachedDepthMask(bool write);
+void cachedColorMask(bool write);  // all four channels
+void cachedBlendFunc(GLenum src, GLenum dst);
+void cachedCullFace(GLenum mode);
+void cachedClearColor(float r, float g, float b, float a);
+
+// Delete the objects and drop them from the cache so a recycled name is never mistaken for them.
+void cachedDeleteBuffers(GLsizei n, const GLuint* buffers);
+void cachedDeleteVertexArrays(GLsizei n, const GLuint* vaos);
+void cachedDeleteTextures(GLsizei n, const GLuint* textures);
+void cachedDeleteProgram(GLuint program);
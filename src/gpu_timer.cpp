@@ -0,0 +1,113 @@
+#include "gpu_timer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+GpuTimers createGpuTimers() {
+    GpuTimers timers = {};
+    glGenQueries(GPU_TIMER_LATENCY * GPU_TIMER_MAX_SCOPES * 2, &timers.queries[0][0]);
+    return timers;
+}
+
+void freeGpuTimers(GpuTimers& timers) {
+    glDeleteQueries(GPU_TIMER_LATENCY * GPU_TIMER_MAX_SCOPES * 2, &timers.queries[0][0]);
+    timers = {};
+}
+
+int gpuTimerScope(GpuTimers& timers, const char* name) {
+    for (size_t i = 0; i < timers.names.size(); ++i)
+        if (timers.names[i] == name) return (int)i;
+    if (timers.names.size() == GPU_TIMER_MAX_SCOPES) throw std::runtime_error("Too many GPU timer scopes");
+    timers.names.push_back(name);
+    timers.history.emplace_back();
+    timers.recorded.emplace_back();
+    timers.sampleCount.push_back(0);
+    return (int)timers.names.size() - 1;
+}
+
+// Collects the slot about to be reused. Its queries were issued GPU_TIMER_LATENCY - 1
+// frames ago; any that are still not available are dropped rather than waited on.
+void gpuTimersBeginFrame(GpuTimers& timers) {
+    timers.frame = (timers.frame + 1) % GPU_TIMER_LATENCY;
+    GLuint* queries = timers.queries[timers.frame];
+    bool* issued = timers.issued[timers.frame];
+    for (size_t scope = 0; scope < timers.names.size(); ++scope) {
+        if (!issued[scope]) continue;
+        issued[scope] = false;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[scope * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) { ++timers.dropped; continue; }
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[scope * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[scope * 2 + 1], GL_QUERY_RESULT, &end);
+
+        std::vector<float>& history = timers.history[scope];
+        float ms = (float)((double)(end - begin) / 1e6);
+        if (history.size() < GPU_TIMER_HISTORY) history.push_back(ms);
+        else history[timers.sampleCount[scope] % GPU_TIMER_HISTORY] = ms;
+        ++timers.sampleCount[scope];
+        if (timers.recordSlot[timers.frame]) timers.recorded[scope].push_back(ms);
+    }
+    timers.recordSlot[timers.frame] = timers.recording;
+}
+
+void gpuTimerBegin(GpuTimers& timers, int scope) {
+    glQueryCounter(timers.queries[timers.frame][scope * 2], GL_TIMESTAMP);
+}
+
+void gpuTimerEnd(GpuTimers& timers, int scope) {
+    glQueryCounter(timers.queries[timers.frame][scope * 2 + 1], GL_TIMESTAMP);
+    timers.issued[timers.frame][scope] = true;
+}
+
+void gpuTimersRecord(GpuTimers& timers, bool recording) {
+    timers.recording = recording;
+}
+
+void gpuTimersFlush(GpuTimers& timers) {
+    glFinish();
+    bool recording = timers.recording;
+    timers.recording = false;
+    for (int i = 0; i < GPU_TIMER_LATENCY; ++i) gpuTimersBeginFrame(timers);
+    timers.recording = recording;
+}
+
+float gpuTimerLatest(const GpuTimers& timers, int scope) {
+    uint64_t count = timers.sampleCount[scope];
+    if (count == 0) return -1.f;
+    return timers.history[scope][(count - 1) % GPU_TIMER_HISTORY];
+}
+
+std::vector<GpuTimerStats> gpuTimerStats(const GpuTimers& timers) {
+    std::vector<GpuTimerStats> stats;
+    for (size_t scope = 0; scope < timers.names.size(); ++scope) {
+        GpuTimerStats s;
+        static_cast<TimeStats&>(s) = summarizeTimes(timers.history[scope]);
+        s.name = timers.names[scope];
+        stats.push_back(s);
+    }
+    return stats;
+}
+
+std::string gpuTimersJson(const GpuTimers& timers) {
+    std::string json = "{\n  \"latency_frames\": " + std::to_string(GPU_TIMER_LATENCY) +
+                       ",\n  \"dropped\": " + std::to_string(timers.dropped) + ",\n  \"scopes\": [";
+    std::vector<GpuTimerStats> stats = gpuTimerStats(timers);
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const GpuTimerStats& s = stats[i];
+        char line[512];
+        snprintf(line, sizeof(line), "%s\n    { \"name\": \"%s\", \"samples\": %u, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+                 "\"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f }",
+                 i ? "," : "", s.name.c_str(), s.samples, s.meanMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs);
+        json += line;
+    }
+    return json + "\n  ]\n}\n";
+}
+
+bool writeGpuTimersJson(const GpuTimers& timers, const char* path) {
+    std::ofstream file(path);
+    if (!file) return false;
+    file << gpuTimersJson(timers);
+    return (bool)file;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "frame_stats.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Named GPU timing scopes built on GL_TIMESTAMP queries. Each frame writes into its own
+// set of query objects and results are read GPU_TIMER_LATENCY - 1 frames later, when the
+// GPU is long done with them, so timing never stalls the pipeline. Every scope keeps a
+// rolling window of samples for averages and percentiles; while recording, every sample
+// is also kept in full for benchmark runs.
+
+const int GPU_TIMER_LATENCY = 4;
+const int GPU_TIMER_MAX_SCOPES = 32;
+const uint32_t GPU_TIMER_HISTORY = 240;
+
+struct GpuTimerStats : TimeStats {
+    std::string name;
+};
+
+struct GpuTimers {
+    GLuint queries[GPU_TIMER_LATENCY][GPU_TIMER_MAX_SCOPES * 2];
+    bool issued[GPU_TIMER_LATENCY][GPU_TIMER_MAX_SCOPES];
+    int frame;
+    std::vector<std::string> names;
+    std::vector<std::vector<float>> history;  // ring of the last GPU_TIMER_HISTORY samples in ms
+    std::vector<uint64_t> sampleCount;
+    uint64_t dropped;
+    bool recording;
+    bool recordSlot[GPU_TIMER_LATENCY];       // whether the frame that used each slot was recording
+    std::vector<std::vector<float>> recorded;  // every sample from recorded frames
+};
+
+GpuTimers createGpuTimers();
+void freeGpuTimers(GpuTimers& timers);
+// Registers a scope once; the returned id is what gpuTimerBegin/End take every frame.
+int gpuTimerScope(GpuTimers& timers, const char* name);
+void gpuTimersBeginFrame(GpuTimers& timers);
+void gpuTimerBegin(GpuTimers& timers, int scope);
+void gpuTimerEnd(GpuTimers& timers, int scope);
+// Frames begun while recording keep all of their samples in timers.recorded.
+void gpuTimersRecord(GpuTimers& timers, bool recording);
+// Waits for the GPU and collects every outstanding query.
+void gpuTimersFlush(GpuTimers& timers);
+
+// Most recent sample of a scope in ms, or -1 before the first one arrives.
+float gpuTimerLatest(const GpuTimers& timers, int scope);
+std::vector<GpuTimerStats> gpuTimerStats(const GpuTimers& timers);
+std::string gpuTimersJson(const GpuTimers& timers);
+bool writeGpuTimersJson(const GpuTimers& timers, const char* path);
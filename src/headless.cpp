@@ -0,0 +1,116 @@
+#include "headless.h"
+
+#ifdef OBJ_VIEWER_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+
+struct HeadlessContext {
+    EGLDisplay display;
+    EGLConfig config;
+    EGLContext context;
+    EGLSurface surface;
+    bool shared;  // shared contexts borrow the display of the context they were made from
+};
+
+static bool hasEGLExtension(EGLDisplay display, const char* name) {
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    return extensions && strstr(extensions, name) != nullptr;
+}
+
+static EGLDisplay openDisplay() {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay && hasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) return display;
+    return EGL_NO_DISPLAY;
+}
+
+HeadlessContext* createHeadlessContext(int major, int minor) {
+    EGLDisplay display = openDisplay();
+    if (display == EGL_NO_DISPLAY || !eglBindAPI(EGL_OPENGL_API)) return nullptr;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        eglTerminate(display);
+        return nullptr;
+    }
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE,
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        return nullptr;
+    }
+
+    // Rendering goes to an FBO, so a surface is only created when the driver insists.
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!hasEGLExtension(display, "EGL_KHR_surfaceless_context")) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    }
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return nullptr;
+    }
+    return new HeadlessContext{ display, config, context, surface, false };
+}
+
+HeadlessContext* createSharedHeadlessContext(HeadlessContext* share, int major, int minor) {
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE,
+    };
+    EGLContext context = eglCreateContext(share->display, share->config, share->context, contextAttribs);
+    if (context == EGL_NO_CONTEXT) return nullptr;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (share->surface != EGL_NO_SURFACE) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(share->display, share->config, pbufferAttribs);
+    }
+    return new HeadlessContext{ share->display, share->config, context, surface, true };
+}
+
+bool makeHeadlessContextCurrent(HeadlessContext* context, bool current) {
+    if (!current) return eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    return eglMakeCurrent(context->display, context->surface, context->surface, context->context);
+}
+
+void destroyHeadlessContext(HeadlessContext* context) {
+    if (!context) return;
+    // A shared context is no longer current anywhere; unbinding here would unbind the
+    // caller's own context instead.
+    if (!context->shared) eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context->surface != EGL_NO_SURFACE) eglDestroySurface(context->display, context->surface);
+    eglDestroyContext(context->display, context->context);
+    if (!context->shared) eglTerminate(context->display);
+    delete context;
+}
+
+GLADloadproc headlessProcLoader() {
+    return (GLADloadproc)eglGetProcAddress;
+}
+
+#else
+
+HeadlessContext* createHeadlessContext(int, int) { return nullptr; }
+HeadlessContext* createSharedHeadlessContext(HeadlessContext*, int, int) { return nullptr; }
+bool makeHeadlessContextCurrent(HeadlessContext*, bool) { return false; }
+void destroyHeadlessContext(HeadlessContext*) {}
+GLADloadproc headlessProcLoader() { return nullptr; }
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include <glad/glad.h>
+
+// GL context without a window for servers and CI hosts. It uses EGL, preferring Mesa's
+// surfaceless platform and falling back to a 1x1 pbuffer on the default display, so
+// llvmpipe works on machines with no GPU or display. Only built when OBJ_VIEWER_HEADLESS
+// is defined (Linux, link with -lEGL); otherwise createHeadlessContext returns null.
+
+struct HeadlessContext;
+
+HeadlessContext* createHeadlessContext(int major, int minor);
+// A context sharing objects with share, for another thread; it starts out current nowhere.
+// Destroy it before share.
+HeadlessContext* createSharedHeadlessContext(HeadlessContext* share, int major, int minor);
+// Binds the context to the calling thread, or with current false unbinds whatever is bound.
+bool makeHeadlessContextCurrent(HeadlessContext* context, bool current);
+void destroyHeadlessContext(HeadlessContext* context);
+GLADloadproc headlessProcLoader();
@@ -0,0 +1,78 @@
+#include "indirect.h"
+
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "matrix.h"
+
+DrawBatch createDrawBatch(const MeshPool& pool, uint32_t capacity, bool positionsOnly) {
+    DrawBatch batch = {};
+    batch.vao = positionsOnly ? pool.positionVao : pool.vao;
+    batch.indirect = GLExt.multiDrawIndirect;
+    batch.commandCapacity = capacity;
+    batch.transforms = createInstanceBuffer(capacity);
+    if (batch.indirect) {
+        glGenBuffers(1, &batch.commandBuffer);
+        cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+        cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        attachInstanceBuffer(batch.vao, batch.transforms);
+    } else {
+        // The pool VAOs leave the instance attributes disabled, so they read the current
+        // generic attribute value; make that the identity and carry the model in ObjectBlock.
+        for (GLuint i = 0; i < 7; ++i) {
+            GLuint column = i < 4 ? i : i - 4;
+            glVertexAttrib4f(INSTANCE_MATRIX_LOCATION + i, column == 0 ? 1.f : 0.f, column == 1 ? 1.f : 0.f,
+                             column == 2 ? 1.f : 0.f, column == 3 ? 1.f : 0.f);
+        }
+    }
+    return batch;
+}
+
+void freeDrawBatch(DrawBatch& batch) {
+    if (batch.commandBuffer) cachedDeleteBuffers(1, &batch.commandBuffer);
+    freeInstanceBuffer(batch.transforms);
+    batch = {};
+}
+
+void clearDrawBatch(DrawBatch& batch) {
+    batch.commands.clear();
+    batch.instances.clear();
+}
+
+void addDraw(DrawBatch& batch, const MeshRange& range, const float* instance) {
+    GLuint index = (GLuint)batch.commands.size();
+    batch.commands.push_back({ range.indexCount, 1, range.firstIndex, range.baseVertex, index });
+    batch.instances.insert(batch.instances.end(), instance, instance + INSTANCE_FLOATS);
+}
+
+void submitDrawBatch(DrawBatch& batch, UniformRing& uniforms, const ObjectUniforms& object) {
+    GLsizei count = (GLsizei)batch.commands.size();
+    if (count == 0) return;
+    cachedBindVertexArray(batch.vao);
+
+    if (batch.indirect) {
+        GLsizeiptr size = (GLsizeiptr)count * sizeof(DrawElementsIndirectCommand);
+        cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.commandBuffer);
+        if ((uint32_t)count > batch.commandCapacity) {
+            batch.commandCapacity = (uint32_t)count;
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, size, batch.commands.data(), GL_DYNAMIC_DRAW);
+        } else {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)batch.commandCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, batch.commands.data());
+        }
+        uploadInstances(batch.transforms, batch.instances.data(), (uint32_t)count);
+        uniformRingBindBlock(uniforms, OBJECT_BLOCK_BINDING, &object, sizeof(object));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, count, 0);
+        return;
+    }
+
+    ObjectUniforms drawObject = object;
+    for (GLsizei i = 0; i < count; ++i) {
+        const DrawElementsIndirectCommand& cmd = batch.commands[i];
+        mat4_mul(drawObject.model, &batch.instances[(size_t)i * INSTANCE_FLOATS], object.model);
+        mat4_normal_matrix(drawObject.normalMatrix, drawObject.model);
+        uniformRingBindBlock(uniforms, OBJECT_BLOCK_BINDING, &drawObject, sizeof(drawObject));
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)cmd.count, GL_UNSIGNED_INT,
+            (void*)((size_t)cmd.firstIndex * sizeof(uint32_t)), cmd.baseVertex);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "instancing.h"
+#include "mesh_pool.h"
+#include "shader_blocks.h"
+#include "uniform_ring.h"
+
+#include <vector>
+
+// A list of draws from one MeshPool submitted with a single glMultiDrawElementsIndirect.
+// Per-draw instance records (model and normal matrix) are written to an instance buffer
+// attached to the pool VAO and command i uses baseInstance = i to fetch its own record, so submission costs the same
+// handful of calls whatever the draw count. On GL 3.3 the batch falls back to one
+// ObjectBlock bind plus one glDrawElementsBaseVertex per draw.
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct DrawBatch {
+    GLuint vao;
+    GLuint commandBuffer;
+    uint32_t commandCapacity;
+    InstanceBuffer transforms;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<float> instances;  // INSTANCE_FLOATS per draw
+    bool indirect;
+};
+
+// positionsOnly draws through the pool's position-only VAO, for depth-only passes.
+DrawBatch createDrawBatch(const MeshPool& pool, uint32_t capacity, bool positionsOnly = false);
+void freeDrawBatch(DrawBatch& batch);
+void clearDrawBatch(DrawBatch& batch);
+// instance is one INSTANCE_FLOATS record, see writeInstances.
+void addDraw(DrawBatch& batch, const MeshRange& range, const float* instance);
+void submitDrawBatch(DrawBatch& batch, UniformRing& uniforms, const ObjectUniforms& object);
@@ -0,0 +1,80 @@
+#include "instancing.h"
+
+#include "gl_state.h"
+#include "matrix.h"
+
+#include <cmath>
+#include <cstring>
+
+InstanceBuffer createInstanceBuffer(uint32_t capacity) {
+    InstanceBuffer instances = {};
+    instances.capacity = capacity;
+    glGenBuffers(1, &instances.buffer);
+    cachedBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * INSTANCE_FLOATS * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    return instances;
+}
+
+void freeInstanceBuffer(InstanceBuffer& instances) {
+    cachedDeleteBuffers(1, &instances.buffer);
+    instances = {};
+}
+
+void attachInstanceBuffer(GLuint vao, const InstanceBuffer& instances) {
+    cachedBindVertexArray(vao);
+    cachedBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    const GLsizei stride = INSTANCE_FLOATS * sizeof(float);
+    for (GLuint i = 0; i < 7; ++i) {
+        // Locations 3-6 are the model matrix columns, 7-9 the normal matrix columns.
+        GLuint location = INSTANCE_MATRIX_LOCATION + i;
+        glVertexAttribPointer(location, i < 4 ? 4 : 3, GL_FLOAT, GL_FALSE, stride, (void*)(i * 4 * sizeof(float)));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    cachedBindVertexArray(0);
+}
+
+void writeInstances(float* instances, const float* matrices, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        float* instance = instances + (size_t)i * INSTANCE_FLOATS;
+        memcpy(instance, matrices + (size_t)i * 16, 16 * sizeof(float));
+        mat4_normal_matrix(instance + 16, instance);
+    }
+}
+
+void uploadInstances(InstanceBuffer& instances, const float* data, uint32_t count) {
+    GLsizeiptr size = (GLsizeiptr)count * INSTANCE_FLOATS * sizeof(float);
+    cachedBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    if (count > instances.capacity) {
+        instances.capacity = count;
+        glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)instances.capacity * INSTANCE_FLOATS * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+    }
+    instances.count = count;
+}
+
+static uint32_t gridSide(uint32_t count) {
+    uint32_t side = 1;
+    while (side * side * side < count) ++side;
+    return side;
+}
+
+// Fills a cube-shaped grid centred on the origin, one translation matrix per instance.
+void layoutInstanceGrid(float* matrices, uint32_t count, float spacing) {
+    uint32_t side = gridSide(count);
+    float half = (side - 1) * spacing * 0.5f;
+    for (uint32_t i = 0; i < count; ++i) {
+        float* m = matrices + i * 16;
+        for (int j = 0; j < 16; ++j) m[j] = (j % 5 == 0) ? 1.f : 0.f;
+        m[12] = (i % side) * spacing - half;
+        m[13] = (i / side % side) * spacing - half;
+        m[14] = (i / (side * side)) * spacing - half;
+    }
+}
+
+float instanceGridRadius(uint32_t count, float spacing) {
+    uint32_t side = gridSide(count);
+    return (side - 1) * spacing * 0.5f * sqrtf(3.f);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Per-instance model matrices streamed into a VBO and read through four vec4
+// attributes with a divisor of 1, so one glDrawElementsInstanced covers every copy.
+// Each instance also carries its normal matrix (three vec3 attributes), computed on the
+// CPU so the vertex shader does not invert the model matrix per vertex.
+
+const GLuint INSTANCE_MATRIX_LOCATION = 3;
+const GLuint INSTANCE_NORMAL_LOCATION = 7;
+// Floats per instance: the model matrix followed by the normal matrix in std140 mat3 layout.
+const uint32_t INSTANCE_FLOATS = 28;
+
+struct InstanceBuffer {
+    GLuint buffer;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+InstanceBuffer createInstanceBuffer(uint32_t capacity);
+void freeInstanceBuffer(InstanceBuffer& instances);
+void attachInstanceBuffer(GLuint vao, const InstanceBuffer& instances);
+// Packs count model matrices and their normal matrices into INSTANCE_FLOATS records.
+void writeInstances(float* instances, const float* matrices, uint32_t count);
+void uploadInstances(InstanceBuffer& instances, const float* data, uint32_t count);
+
+void layoutInstanceGrid(float* matrices, uint32_t count, float spacing);
+float instanceGridRadius(uint32_t count, float spacing);
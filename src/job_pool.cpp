@@ -0,0 +1,232 @@
+#include "job_pool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct Job {
+    JobFunction function;
+    JobCounter* counter;
+};
+
+// Chase-Lev deque over a fixed ring. The owner pushes and pops at the bottom; thieves
+// take from the top, and the owner and a thief race with a CAS on top only for the last job.
+static const int64_t DEQUE_CAPACITY = 4096;
+
+struct JobDeque {
+    std::atomic<int64_t> top{0}, bottom{0};
+    std::atomic<Job*> ring[DEQUE_CAPACITY];
+};
+
+static bool pushJob(JobDeque& deque, Job* job) {
+    int64_t b = deque.bottom.load(std::memory_order_relaxed);
+    if (b - deque.top.load(std::memory_order_acquire) >= DEQUE_CAPACITY) return false;
+    deque.ring[b & (DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    deque.bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+static Job* popJob(JobDeque& deque) {
+    int64_t b = deque.bottom.load(std::memory_order_relaxed) - 1;
+    deque.bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = deque.top.load(std::memory_order_seq_cst);
+    if (t > b) {
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = deque.ring[b & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+static Job* stealJob(JobDeque& deque) {
+    int64_t t = deque.top.load(std::memory_order_seq_cst);
+    int64_t b = deque.bottom.load(std::memory_order_seq_cst);
+    if (t >= b) return nullptr;
+    Job* job = deque.ring[t & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return job;
+}
+
+// The pool and deque index of the current thread when it is a worker.
+static thread_local JobPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+static void submitJob(JobPool* pool, Job* job) {
+    pool->queued.fetch_add(1);
+    bool pushed = currentPool == pool && pushJob(*pool->deques[currentWorker], job);
+    if (!pushed) {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->injected.push_back(job);
+        pool->injectedCount.fetch_add(1);
+    }
+    // queued is raised before sleeping is read, and a worker raises sleeping before it
+    // reads queued, so one of the two sees the other and no wakeup is lost.
+    if (pool->sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->wake.notify_one();
+    }
+}
+
+static void finishJob(JobPool* pool, Job* job) {
+    JobCounter* counter = job->counter;
+    delete job;
+    if (!counter) return;
+    std::vector<Job*> released;
+    {
+        // Waiters lock the mutex after seeing zero, so the counter outlives this block.
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1) == 1) released.swap(counter->waiting);
+    }
+    for (Job* next : released) submitJob(pool, next);
+}
+
+// Own deque first, then jobs from outside the pool, then other workers' deques.
+static Job* findJob(JobPool* pool) {
+    Job* job = nullptr;
+    if (currentPool == pool) job = popJob(*pool->deques[currentWorker]);
+    if (!job && pool->injectedCount.load() > 0) {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->injected.empty()) {
+            job = pool->injected.front();
+            pool->injected.pop_front();
+            pool->injectedCount.fetch_sub(1);
+        }
+    }
+    if (!job) {
+        size_t count = pool->deques.size();
+        size_t start = currentPool == pool ? currentWorker + 1 : 0;
+        for (size_t i = 0; i < count && !job; ++i) {
+            job = stealJob(*pool->deques[(start + i) % count]);
+            if (job) pool->steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (job) pool->queued.fetch_sub(1);
+    return job;
+}
+
+static bool runOneJob(JobPool* pool) {
+    Job* job = findJob(pool);
+    if (!job) return false;
+    job->function();
+    finishJob(pool, job);
+    return true;
+}
+
+static void workerLoop(JobPool* pool, int index) {
+    currentPool = pool;
+    currentWorker = index;
+    while (!pool->quit.load()) {
+        if (runOneJob(pool)) continue;
+        // A short spin catches jobs that follow closely before paying for a sleep.
+        bool found = false;
+        for (int spin = 0; spin < 64 && !found; ++spin) {
+            std::this_thread::yield();
+            found = pool->queued.load() > 0;
+        }
+        if (found) continue;
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->sleeping.fetch_add(1);
+        pool->wake.wait(lock, [&] { return pool->quit.load() || pool->queued.load() > 0; });
+        pool->sleeping.fetch_sub(1);
+    }
+}
+
+JobPool* createJobPool(unsigned workers, bool pin) {
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    JobPool* pool = new JobPool();
+    pool->queued = 0;
+    pool->injectedCount = 0;
+    pool->sleeping = 0;
+    pool->steals = 0;
+    pool->quit = false;
+    for (unsigned i = 0; i < workers; ++i) pool->deques.push_back(new JobDeque());
+    for (unsigned i = 0; i < workers; ++i) {
+        pool->workers.emplace_back(workerLoop, pool, (int)i);
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET((i + 1) % hardware, &cpus);
+            pthread_setaffinity_np(pool->workers.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)pin;
+#endif
+    }
+    return pool;
+}
+
+void freeJobPool(JobPool* pool) {
+    if (!pool) return;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->wake.notify_all();
+    for (std::thread& worker : pool->workers) worker.join();
+    for (JobDeque* deque : pool->deques) delete deque;
+    delete pool;
+}
+
+unsigned defaultJobPoolWorkers() {
+    return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+unsigned jobPoolThreadCount(const JobPool* pool) {
+    return pool ? (unsigned)pool->workers.size() + 1 : 1;
+}
+
+void runJob(JobPool* pool, JobFunction function, JobCounter* counter, JobCounter* after) {
+    if (!pool) {
+        function();
+        return;
+    }
+    Job* job = new Job{ std::move(function), counter };
+    if (counter) counter->pending.fetch_add(1);
+    if (after) {
+        std::lock_guard<std::mutex> lock(after->mutex);
+        if (after->pending.load() > 0) {
+            after->waiting.push_back(job);
+            return;
+        }
+    }
+    submitJob(pool, job);
+}
+
+void waitForCounter(JobPool* pool, JobCounter& counter) {
+    while (counter.pending.load(std::memory_order_acquire) != 0)
+        if (!pool || !runOneJob(pool)) std::this_thread::yield();
+    // The last job may still be inside finishJob's lock.
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+// Keeps the first chunk and hands the upper half of the rest to the pool, so idle threads
+// steal large pieces and split them further themselves.
+static void splitRange(JobPool* pool, JobCounter* counter, const RangeJob* job, uint32_t begin, uint32_t end, uint32_t grain) {
+    while (end - begin > grain) {
+        uint32_t chunks = (end - begin + grain - 1) / grain;
+        uint32_t mid = begin + chunks / 2 * grain;
+        runJob(pool, [=] { splitRange(pool, counter, job, mid, end, grain); }, counter);
+        end = mid;
+    }
+    (*job)(begin, end);
+}
+
+void parallelFor(JobPool* pool, uint32_t count, uint32_t grain, const RangeJob& job) {
+    if (count == 0) return;
+    grain = std::max(grain, 1u);
+    if (!pool || pool->workers.empty() || count <= grain) {
+        job(0, count);
+        return;
+    }
+    JobCounter counter;
+    splitRange(pool, &counter, &job, 0, count, grain);
+    waitForCounter(pool, counter);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job scheduler. Each worker owns a deque: it pushes and pops jobs at the
+// bottom while idle workers steal from the top. Threads outside the pool submit through a
+// shared queue and run jobs themselves while they wait, so any thread may submit work, and
+// jobs may submit and wait on more jobs.
+//
+// Counters group jobs: a job started with a counter adds one to it and takes one off when
+// it finishes. Waiting on a counter runs other jobs until it reaches zero, and a job can be
+// held back until a counter reaches zero, which is how dependencies are expressed.
+
+typedef std::function<void()> JobFunction;
+typedef std::function<void(uint32_t begin, uint32_t end)> RangeJob;
+
+struct Job;
+struct JobDeque;
+
+struct JobCounter {
+    std::atomic<uint32_t> pending{0};
+    std::mutex mutex;
+    std::vector<Job*> waiting;  // jobs held until pending reaches zero
+};
+
+struct JobPool {
+    std::vector<std::thread> workers;
+    std::vector<JobDeque*> deques;  // one per worker
+    std::mutex mutex;  // guards injected and the sleep handshake
+    std::condition_variable wake;
+    std::deque<Job*> injected;  // jobs from threads outside the pool, oldest first
+    std::atomic<uint32_t> injectedCount;
+    std::atomic<uint32_t> queued;  // jobs in deques and injected
+    std::atomic<uint32_t> sleeping;
+    std::atomic<uint64_t> steals;
+    std::atomic<bool> quit;
+};
+
+// Starts the given number of workers; with none, waiting threads run every job themselves.
+// pin ties worker i to CPU i + 1, leaving CPU 0 to the main thread (Linux only).
+JobPool* createJobPool(unsigned workers, bool pin = false);
+// One worker per hardware thread besides the caller.
+unsigned defaultJobPoolWorkers();
+void freeJobPool(JobPool* pool);
+// Workers plus the calling thread.
+unsigned jobPoolThreadCount(const JobPool* pool);
+
+// Queues a job, run inline when pool is null. counter, when given, counts the job until it
+// finishes; after, when given, holds the job until that counter reaches zero. Jobs must
+// not throw.
+void runJob(JobPool* pool, JobFunction function, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+// Runs queued jobs until the counter reaches zero. The counter may be reused afterwards.
+void waitForCounter(JobPool* pool, JobCounter& counter);
+
+// Splits [0, count) into grain-sized chunks, starting at multiples of grain, and runs job
+// once per chunk across the pool. Without a pool the whole range is one call. Returns when
+// every chunk has run.
+void parallelFor(JobPool* pool, uint32_t count, uint32_t grain, const RangeJob& job);
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded queue that any number of threads may push to and pop from without locks
+// (Dmitry Vyukov's design). Each cell carries a sequence number that tells a producer
+// whether the cell is free for its position and a consumer whether it has been filled,
+// so the only contended operations are the CAS on the two positions. Pushing to a full
+// queue and popping an empty one fail instead of waiting.
+
+template <typename T>
+struct LockFreeQueue {
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> pushPosition;
+    alignas(64) std::atomic<size_t> popPosition;
+};
+
+// Capacity is rounded up to a power of two.
+template <typename T>
+void initLockFreeQueue(LockFreeQueue<T>& queue, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    queue.cells.reset(new typename LockFreeQueue<T>::Cell[size]);
+    for (size_t i = 0; i < size; ++i) queue.cells[i].sequence.store(i, std::memory_order_relaxed);
+    queue.mask = size - 1;
+    queue.pushPosition.store(0, std::memory_order_relaxed);
+    queue.popPosition.store(0, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool tryPush(LockFreeQueue<T>& queue, const T& value) {
+    size_t position = queue.pushPosition.load(std::memory_order_relaxed);
+    for (;;) {
+        typename LockFreeQueue<T>::Cell& cell = queue.cells[position & queue.mask];
+        intptr_t ahead = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)position;
+        if (ahead == 0) {
+            if (queue.pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell.value = value;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (ahead < 0) {
+            return false;  // the cell still holds a value from a lap ago
+        } else {
+            position = queue.pushPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool tryPop(LockFreeQueue<T>& queue, T& value) {
+    size_t position = queue.popPosition.load(std::memory_order_relaxed);
+    for (;;) {
+        typename LockFreeQueue<T>::Cell& cell = queue.cells[position & queue.mask];
+        intptr_t ahead = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+        if (ahead == 0) {
+            if (queue.popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                value = cell.value;
+                cell.sequence.store(position + queue.mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (ahead < 0) {
+            return false;  // not filled yet
+        } else {
+            position = queue.popPosition.load(std::memory_order_relaxed);
+        }
+    }
+}
@@ -3,245 +3,1476 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <tiny_obj_loader.h>
+
+#include "benchmarks.h"
+#include "clustered_lights.h"
+#include "culling.h"
+#include "depth_prepass.h"
+#include "dynamic_resolution.h"
+#include "ecs.h"
+#include "frame_graph.h"
+#include "frame_graph_gl.h"
+#include "frame_queue.h"
+#include "frame_stats.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "headless.h"
+#include "indirect.h"
+#include "instancing.h"
+#include "job_pool.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "mesh_pool.h"
+#include "mesh_uploader.h"
+#include "occlusion.h"
+#include "program_cache.h"
+#include "render_target.h"
+#include "render_queue.h"
+#include "shader_blocks.h"
+#include "soft_raster.h"
+#include "stream_buffer.h"
+#include "uniform_ring.h"
 
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <chrono>
 #include <vector>
-#include <unordered_map>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <thread>
 
-struct vec2 { float x, y; };
-struct vec3 { float x, y, z; };
-
-struct Vertex {
-    vec3 position;
-    vec3 normal;
-    vec2 texcoords;
-    bool operator==(const Vertex& other) const {
-        return memcmp(this, &other, sizeof(Vertex)) == 0;
-    }
+struct Options {
+    uint32_t instances = 1;
+    uint32_t draws = 0;
+    uint32_t lights = 0;
+    std::vector<std::string> meshes;
+    bool asyncLoad = false;
+    bool cull = true;
+    PrepassMode prepass = PREPASS_AUTO;
+    bool occlusion = false;
+    bool benchInstances = false;
+    float benchBudgetMs = 16.7f;
+    uint32_t benchCull = 0;
+    uint32_t benchOcclusion = 0;
+    uint32_t benchMatrix = 0;
+    uint32_t benchFrameGraph = 0;
+    uint32_t benchScene = 0;
+    uint32_t benchEcs = 0;
+    uint32_t benchJobs = 0;
+    uint32_t benchQueue = 0;
+    uint32_t benchStreamMB = 0;
+    uint32_t benchArena = 0;
+    std::string gpuTimingsPath;
+    bool stateStats = false;
+    std::string benchRunPath;
+    int swapInterval = -1;  // -1 keeps the driver default
+    uint32_t benchFrames = 0;
+    float benchSeconds = 0.f;
+    uint32_t warmupFrames = 60;
+    bool headless = false;
+    std::string outputPattern = "frame_####.tga";
+    int width = 800, height = 600;
+    float renderScale = 1.f;
+    float resolutionBudgetMs = 0.f;  // > 0 enables dynamic resolution
+    float minRenderScale = 0.5f;
+    std::string shaderCacheDir = "shader_cache";
+    bool software = false;
+    uint32_t threads = 0;  // 0 = one per hardware thread
+    uint32_t renderThreadSlots = 0;  // > 0 renders on a separate thread through this many packet slots
+    bool pinThreads = false;
 };
 
-namespace std {
-    template<> struct hash<Vertex> {
-        std::size_t operator()(const Vertex& v) const {
-            size_t h1 = hash<float>()(v.position.x) ^ hash<float>()(v.position.y) ^ hash<float>()(v.position.z);
-            size_t h2 = hash<float>()(v.normal.x) ^ hash<float>()(v.normal.y) ^ hash<float>()(v.normal.z);
-            size_t h3 = hash<float>()(v.texcoords.x) ^ hash<float>()(v.texcoords.y);
-            return h1 ^ (h2 << 1) ^ (h3 << 2);
-        }
-    };
-}
+// Camera distance and projection that frame a grid of objectCount objects.
+struct SceneView {
+    float radius, distance;
+    float fovy, aspect, zNear, farPlane;
+};
 
-struct Mesh {
-    Vertex* vertices;
-    uint32_t* indices;
-    uint32_t vertexCount;
-    uint32_t indexCount;
+// What the simulation hands the renderer for one frame. Packet slots are reused, so the
+// render side keeps nothing that points into one after releasing it.
+struct FramePacket {
+    uint64_t index;
+    float time;
+    FrameUniforms frame;
+    SceneView view;
+    float model[16];  // rotation applied to every object
+    std::vector<PointLight> lights;
+    int framebufferWidth, framebufferHeight;
+    double inputSeconds;  // when input was polled for this frame
+    double publishedSeconds;
 };
 
+Options parseOptions(int argc, char** argv);
+SceneView setupSceneView(FrameUniforms& frame, uint32_t objectCount, float spacing, float aspect);
+int runSoftwareRenderer(const Options& options, JobPool* jobs);
+double nowSeconds();
+std::string framePath(const std::string& pattern, uint32_t frame);
 void framebuffer_size_callback(GLFWwindow*, int, int);
 void processInput(GLFWwindow*);
-Mesh loadOBJ(const std::string&);
-void freeMesh(Mesh&);
 GLuint loadTexture(const char* path);
-
-void mat4_identity(float* m) {
-    for (int i = 0; i < 16; ++i) m[i] = (i % 5 == 0) ? 1.f : 0.f;
-}
-void mat4_rotate_y(float* m, float angle) {
-    mat4_identity(m); float c = cosf(angle), s = sinf(angle);
-    m[0] = c; m[2] = s; m[8] = -s; m[10] = c;
-}
-void mat4_translate(float* m, float x, float y, float z) {
-    mat4_identity(m); m[12] = x; m[13] = y; m[14] = z;
-}
-void mat4_perspective(float* m, float fovy, float aspect, float znear, float zfar) {
-    mat4_identity(m);
-    float f = 1.f / tanf(fovy * 0.5f);
-    m[0] = f / aspect; m[5] = f;
-    m[10] = (zfar + znear) / (znear - zfar);
-    m[11] = -1.f; m[14] = (2.f * zfar * znear) / (znear - zfar); m[15] = 0.f;
-}
+GLuint createSolidTexture(unsigned char r, unsigned char g, unsigned char b);
+SoftTexture loadSoftTexture(const char* path);
+void writeWaveGrid(Vertex* out, uint32_t side, float time);
 
 const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aInstance;
+layout (location = 7) in mat3 aInstanceNormal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameBlock { mat4 view; mat4 projection; vec3 lightDir; vec4 clusterScale; };
+layout (std140) uniform ObjectBlock { mat4 model; mat3 normalMatrix; };
 
 out vec3 FragPos;
+out vec3 ViewPos;
 out vec3 Normal;
 out vec2 TexCoords;
+invariant gl_Position;
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat4 world = aInstance * model;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    ViewPos = vec3(view * vec4(FragPos, 1.0));
+    Normal = aInstanceNormal * normalMatrix * aNormal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = projection * vec4(ViewPos, 1.0);
 }
 )";
 
+// Depth prepass: positions only, computed exactly as vertexShaderSource does so the
+// shading pass can test GL_LEQUAL against the depths it wrote.
+const char* depthVertexShaderSource = R"(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aInstance;
+
+layout (std140) uniform FrameBlock { mat4 view; mat4 projection; vec3 lightDir; vec4 clusterScale; };
+layout (std140) uniform ObjectBlock { mat4 model; mat3 normalMatrix; };
+
+invariant gl_Position;
+
+void main() {
+    mat4 world = aInstance * model;
+    vec3 fragPos = vec3(world * vec4(aPos, 1.0));
+    vec3 viewPos = vec3(view * vec4(fragPos, 1.0));
+    gl_Position = projection * vec4(viewPos, 1.0);
+}
+)";
+
+const char* depthFragmentShaderSource = R"(
+#version 330 core
+void main() {}
+)";
+
 const char* fragmentShaderSource = R"(
 #version 330 core
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
 in vec3 FragPos;
+in vec3 ViewPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
 out vec4 FragColor;
 
-uniform vec3 lightDir;
+layout (std140) uniform FrameBlock { mat4 view; mat4 projection; vec3 lightDir; vec4 clusterScale; };
 uniform sampler2D diffuseMap;
+uniform samplerBuffer lightData;      // per light: view position and radius, then color
+uniform usamplerBuffer clusterGrid;   // per cluster: first index and light count
+uniform usamplerBuffer lightIndices;
 
 void main() {
     vec3 norm = normalize(Normal);
     vec3 light = normalize(-lightDir);
     float diff = max(dot(norm, light), 0.0);
     vec3 texColor = texture(diffuseMap, TexCoords).rgb;
-    FragColor = vec4(diff * texColor, 1.0);
+
+    vec3 lighting = vec3(diff);
+    ivec3 cell = clamp(ivec3(gl_FragCoord.xy * clusterScale.xy, log(-ViewPos.z) * clusterScale.z + clusterScale.w),
+                       ivec3(0), ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+    uvec2 range = texelFetch(clusterGrid, (cell.z * CLUSTER_Y + cell.y) * CLUSTER_X + cell.x).xy;
+    vec3 viewNorm = mat3(view) * norm;
+    for (uint i = 0u; i < range.y; ++i) {
+        int index = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 posRadius = texelFetch(lightData, index * 2);
+        vec3 toLight = posRadius.xyz - ViewPos;
+        float dist = length(toLight);
+        float falloff = clamp(1.0 - dist / posRadius.w, 0.0, 1.0);
+        lighting += texelFetch(lightData, index * 2 + 1).rgb * max(dot(viewNorm, toLight / dist), 0.0) * falloff * falloff;
+    }
+    FragColor = vec4(lighting * texColor, 1.0);
 }
 )";
 
-int main() {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow* window = glfwCreateWindow(800, 600, "OBJ Textured Viewer", NULL, NULL);
-    if (!window) return -1;
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) return -1;
+int main(int argc, char** argv) {
+    Options options = parseOptions(argc, argv);
+    JobPool* jobs = createJobPool(options.threads ? options.threads - 1 : defaultJobPoolWorkers(), options.pinThreads);
+    if (options.benchCull || options.benchOcclusion || options.benchMatrix || options.benchFrameGraph || options.benchScene ||
+        options.benchEcs || options.benchJobs) {
+        if (options.benchCull) runCullBenchmark(options.benchCull, jobs);
+        if (options.benchOcclusion) runOcclusionBenchmark(options.benchOcclusion, jobs);
+        if (options.benchMatrix) runMatrixBenchmark(options.benchMatrix);
+        if (options.benchFrameGraph) runFrameGraphBenchmark(options.benchFrameGraph);
+        if (options.benchScene) runSceneGraphBenchmark(options.benchScene, jobs);
+        if (options.benchEcs) runEcsBenchmark(options.benchEcs, jobs);
+        if (options.benchJobs) runJobBenchmark(options.benchJobs, options.pinThreads);
+        freeJobPool(jobs);
+        return 0;
+    }
+    if (options.software) {
+        int result = runSoftwareRenderer(options, jobs);
+        freeJobPool(jobs);
+        return result;
+    }
+    if (options.benchQueue) {
+        // The submission half runs the --draws scene, so every object becomes a queue item.
+        runQueueSortBenchmark(options.benchQueue);
+        options.draws = options.benchQueue;
+        options.cull = false;
+    }
+
+    GLFWwindow* window = nullptr;
+    HeadlessContext* headless = nullptr;
+    GLADloadproc loader;
+    if (options.headless) {
+        headless = createHeadlessContext(3, 3);
+        if (!headless) {
+            std::cerr << "Failed to create a headless GL context (the build needs OBJ_VIEWER_HEADLESS and EGL)" << std::endl;
+            return -1;
+        }
+        loader = headlessProcLoader();
+    } else {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(options.width, options.height, "OBJ Textured Viewer", NULL, NULL);
+        if (!window) return -1;
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        loader = (GLADloadproc)glfwGetProcAddress;
+    }
+    if (!gladLoadGLLoader(loader)) return -1;
+    loadGLExtensions(loader);
+    // Windowed runs swap and poll; headless frames stay in an offscreen target.
+    auto setSwapInterval = [&](int interval) { if (window) glfwSwapInterval(interval); };
+    auto presentFrame = [&] {
+        if (!window) { glFlush(); return; }
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    };
+    auto closeRequested = [&] { return window && glfwWindowShouldClose(window); };
+    if (options.swapInterval >= 0) setSwapInterval(options.swapInterval);
 
     Mesh mesh = loadOBJ("cube.obj");
+    MeshBounds meshBounds = computeMeshBounds(mesh);
     GLuint texID = loadTexture("textures/texture.png");
 
-    GLuint VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO); glGenBuffers(1, &VBO); glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, mesh.vertexCount * sizeof(Vertex), mesh.vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(uint32_t), mesh.indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texcoords));
-    glEnableVertexAttribArray(2);
-    glBindVertexArray(0);
-
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vertexShaderSource, NULL); glCompileShader(vs);
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fragmentShaderSource, NULL); glCompileShader(fs);
-    GLuint sp = glCreateProgram();
-    glAttachShader(sp, vs); glAttachShader(sp, fs); glLinkProgram(sp);
-    glDeleteShader(vs); glDeleteShader(fs);
-
-    while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        float time = glfwGetTime();
-        float model[16], view[16], projection[16];
-        mat4_rotate_y(model, time * 0.5f);
-        mat4_translate(view, 0.f, 0.f, -6.f);
-        mat4_perspective(projection, 3.1415926f / 4.f, 800.f / 600.f, 0.1f, 100.f);
-
-        glUseProgram(sp);
-        glUniformMatrix4fv(glGetUniformLocation(sp, "model"), 1, GL_FALSE, model);
-        glUniformMatrix4fv(glGetUniformLocation(sp, "view"), 1, GL_FALSE, view);
-        glUniformMatrix4fv(glGetUniformLocation(sp, "projection"), 1, GL_FALSE, projection);
-        glUniform3f(glGetUniformLocation(sp, "lightDir"), 0.5f, -1.f, 0.f);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glUniform1i(glGetUniformLocation(sp, "diffuseMap"), 0);
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+    // --draws builds a scene of many objects drawn from the mesh pool through a draw batch.
+    std::vector<Mesh> sceneMeshes;
+    if (options.draws > 0) {
+        if (options.meshes.empty()) options.meshes.push_back("cube.obj");
+        // --async-load leaves them empty here; a loader thread fills them in while frames are drawn.
+        sceneMeshes.resize(options.meshes.size(), Mesh{});
+        if (!options.asyncLoad) {
+            // The files load in parallel; the first failure is rethrown once all have finished.
+            std::vector<std::exception_ptr> errors(options.meshes.size());
+            parallelFor(jobs, (uint32_t)options.meshes.size(), 1, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i) {
+                    try {
+                        sceneMeshes[i] = loadOBJ(options.meshes[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            });
+            for (std::exception_ptr& error : errors)
+                if (error) std::rethrow_exception(error);
+        }
+    }
+    // Every mesh lives in one pool. The instanced mesh gets VAOs of its own over the pool
+    // buffers, so its instance stream and the draw batch's stay separate.
+    uint32_t vertexTotal = mesh.vertexCount, indexTotal = mesh.indexCount;
+    for (const Mesh& sceneMesh : sceneMeshes) {
+        vertexTotal += sceneMesh.vertexCount;
+        indexTotal += sceneMesh.indexCount;
+    }
+    // Meshes loaded in the background have unknown sizes, so they get a fixed budget.
+    if (options.asyncLoad) {
+        vertexTotal += 1u << 20;
+        indexTotal += 1u << 22;
+    }
+    MeshPool pool = createMeshPool(vertexTotal, indexTotal);
+    MeshHandle meshHandle = addMeshToPool(pool, mesh);
+    GLuint VAO = createMeshPoolVao(pool, false);
+    // The same indices with a position-only stream, for the depth prepass.
+    GLuint depthVAO = createMeshPoolVao(pool, true);
+
+    ProgramCacheResult programLoad;
+    GLuint sp = loadCachedProgram(options.shaderCacheDir, vertexShaderSource, fragmentShaderSource, &programLoad);
+    if (programLoad.hit)
+        printf("Shader program loaded from cache in %.2f ms (compiling took %.2f ms, saved %.2f ms)\n",
+               programLoad.ms, programLoad.compileMs, programLoad.compileMs - programLoad.ms);
+    else
+        printf("Shader program compiled in %.2f ms\n", programLoad.ms);
+
+    glUniformBlockBinding(sp, glGetUniformBlockIndex(sp, "FrameBlock"), FRAME_BLOCK_BINDING);
+    glUniformBlockBinding(sp, glGetUniformBlockIndex(sp, "ObjectBlock"), OBJECT_BLOCK_BINDING);
+    GLuint depthProgram = loadCachedProgram(options.shaderCacheDir, depthVertexShaderSource, depthFragmentShaderSource);
+    glUniformBlockBinding(depthProgram, glGetUniformBlockIndex(depthProgram, "FrameBlock"), FRAME_BLOCK_BINDING);
+    glUniformBlockBinding(depthProgram, glGetUniformBlockIndex(depthProgram, "ObjectBlock"), OBJECT_BLOCK_BINDING);
+    cachedUseProgram(sp);
+    glUniform1i(glGetUniformLocation(sp, "diffuseMap"), 0);
+    glUniform1i(glGetUniformLocation(sp, "lightData"), CLUSTER_LIGHT_UNIT);
+    glUniform1i(glGetUniformLocation(sp, "clusterGrid"), CLUSTER_GRID_UNIT);
+    glUniform1i(glGetUniformLocation(sp, "lightIndices"), CLUSTER_INDEX_UNIT);
+
+    // Multi-draw indirect batches bind one ObjectBlock per run of draws sharing state, so a
+    // fixed count covers a frame. The GL 3.3 draw batch fallback binds one per draw, and
+    // prepass frames submit every draw twice: the FrameBlock plus two blocks per draw.
+    GLsizeiptr uniformBlocks = 256;
+    if (!GLExt.multiDrawIndirect) uniformBlocks = std::max<GLsizeiptr>(uniformBlocks, 2 * (GLsizeiptr)options.draws + 4);
+    UniformRing uniforms = createUniformRing(std::max(sizeof(FrameUniforms), sizeof(ObjectUniforms)), uniformBlocks);
+
+    DrawBatch batch = {}, depthBatch = {};
+    // --draws objects are entities. Their MeshRef indexes sceneRanges, which has one range
+    // per mesh, and their MaterialRef indexes the texture table.
+    const ComponentMask sceneObject = componentBit(ECS_TRANSFORM) | componentBit(ECS_MESH) |
+                                      componentBit(ECS_MATERIAL) | componentBit(ECS_BOUNDS);
+    EcsWorld scene = createEcsWorld();
+    // The scene's entities never change after setup, so the query runs once. The culler
+    // reads a copy of their bounds, indexed like the query, that changes only with them.
+    EcsQuery sceneQuery;
+    std::vector<MeshRange> sceneRanges;
+    CullSpheres sceneSpheres;
+    if (options.draws > 0) {
+        std::vector<float> radii;
+        // A mesh still loading has an empty range, so its draws draw nothing until it arrives.
+        for (Mesh& sceneMesh : sceneMeshes) {
+            sceneRanges.push_back(options.asyncLoad ? MeshRange{} : meshRange(pool, addMeshToPool(pool, sceneMesh)));
+            radii.push_back(options.asyncLoad ? 0.f : computeMeshBounds(sceneMesh).radius);
+        }
+        batch = createDrawBatch(pool, options.draws);
+        depthBatch = createDrawBatch(pool, options.draws, true);
+        std::vector<float> layout((size_t)options.draws * 16);
+        layoutInstanceGrid(layout.data(), options.draws, 4.f);
+        // --bench-queue scatters objects over two texture slots.
+        uint32_t seed = 1;
+        for (uint32_t i = 0; i < options.draws; ++i) {
+            Entity entity = createEntity(scene, sceneObject);
+            Transform* transform = (Transform*)entityComponent(scene, entity, ECS_TRANSFORM);
+            memcpy(transform->model, &layout[(size_t)i * 16], sizeof(transform->model));
+            ((MeshRef*)entityComponent(scene, entity, ECS_MESH))->mesh = i % (uint32_t)sceneRanges.size();
+            if (options.benchQueue) {
+                seed = seed * 1664525u + 1013904223u;
+                ((MaterialRef*)entityComponent(scene, entity, ECS_MATERIAL))->textureSlot = seed >> 31;
+            }
+            Bounds* bounds = (Bounds*)entityComponent(scene, entity, ECS_BOUNDS);
+            memcpy(bounds->center, &transform->model[12], sizeof(bounds->center));
+            bounds->radius = radii[i % radii.size()];
+        }
+        runEcsQuery(scene, sceneObject, sceneQuery);
+        sceneSpheres.x.resize(sceneQuery.count);
+        sceneSpheres.y.resize(sceneQuery.count);
+        sceneSpheres.z.resize(sceneQuery.count);
+        sceneSpheres.radius.resize(sceneQuery.count);
+        parallelForQuery(jobs, sceneQuery, [&](const EcsView& view) {
+            const Bounds* bounds = (const Bounds*)ecsArray(view, ECS_BOUNDS);
+            for (uint32_t row = 0; row < view.count; ++row) {
+                uint32_t i = view.first + row;
+                sceneSpheres.x[i] = bounds[row].center[0];
+                sceneSpheres.y[i] = bounds[row].center[1];
+                sceneSpheres.z[i] = bounds[row].center[2];
+                sceneSpheres.radius[i] = bounds[row].radius;
+            }
+        });
+    }
+    // The upload thread gets a context sharing objects with this one: a hidden window, or a
+    // second EGL context when headless.
+    MeshUploader* uploader = nullptr;
+    GLFWwindow* uploadWindow = nullptr;
+    HeadlessContext* uploadContext = nullptr;
+    std::thread loaderThread;
+    std::vector<ReadyMesh> arrivedMeshes;
+    double loadStart = nowSeconds();
+    if (options.asyncLoad && options.draws > 0) {
+        if (headless) {
+            uploadContext = createSharedHeadlessContext(headless, 3, 3);
+            if (!uploadContext) {
+                std::cerr << "Failed to create a shared GL context for uploads" << std::endl;
+                return -1;
+            }
+            uploader = createMeshUploader([=] { makeHeadlessContextCurrent(uploadContext, true); },
+                                          [=] { makeHeadlessContextCurrent(uploadContext, false); });
+        } else {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            uploadWindow = glfwCreateWindow(1, 1, "uploads", NULL, window);
+            if (!uploadWindow) {
+                std::cerr << "Failed to create a shared GL context for uploads" << std::endl;
+                return -1;
+            }
+            uploader = createMeshUploader([=] { glfwMakeContextCurrent(uploadWindow); }, [] { glfwMakeContextCurrent(NULL); });
+        }
+        loaderThread = std::thread([&options, uploader] {
+            for (uint32_t i = 0; i < options.meshes.size() && !uploader->quit; ++i) {
+                try {
+                    Mesh loaded = loadOBJ(options.meshes[i]);
+                    while (!queueMeshUpload(uploader, i, loaded)) {
+                        if (uploader->quit) {
+                            freeMesh(loaded);
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << options.meshes[i] << ": " << e.what() << std::endl;
+                }
+            }
+        });
+    }
+    // Texture slots index this table; --bench-queue scatters objects over two of them.
+    std::vector<GLuint> textures = { texID };
+    if (options.benchQueue) textures.push_back(createSolidTexture(255, 255, 255));
+
+    const float instanceSpacing = 4.f;
+    std::vector<float> instanceMatrices, instanceData, visibleInstances;
+    CullSpheres instanceSpheres;
+    uint32_t instanceCount = 0;
+    InstanceBuffer instances = createInstanceBuffer(options.instances);
+    attachInstanceBuffer(VAO, instances);
+    attachInstanceBuffer(depthVAO, instances);
+    auto setInstanceCount = [&](uint32_t count) {
+        instanceCount = count;
+        instanceMatrices.resize((size_t)count * 16);
+        layoutInstanceGrid(instanceMatrices.data(), count, instanceSpacing);
+        instanceData.resize((size_t)count * INSTANCE_FLOATS);
+        writeInstances(instanceData.data(), instanceMatrices.data(), count);
+        instanceSpheres = CullSpheres();
+        for (uint32_t i = 0; i < count; ++i) {
+            const float* t = &instanceMatrices[(size_t)i * 16];
+            addCullSphere(instanceSpheres, t[12], t[13], t[14], meshBounds.radius);
+        }
+    };
+    setInstanceCount(options.instances);
+    std::vector<uint32_t> visible, occluders;
+    OcclusionBuffer occlusion = createOcclusionBuffer(256, 192);
+
+    // --lights scatters point lights through the scene's volume; they drift around the y axis.
+    std::vector<PointLight> sceneLights;
+    {
+        float extent = std::max(instanceGridRadius(options.draws > 0 ? options.draws : options.instances, instanceSpacing), 4.f);
+        uint32_t seed = 7;
+        auto random = [&] {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 16777216.f;
+        };
+        for (uint32_t i = 0; i < options.lights; ++i) {
+            PointLight l;
+            for (float& p : l.position) p = (random() * 2.f - 1.f) * extent;
+            l.radius = instanceSpacing * (1.f + random());
+            for (float& c : l.color) c = 0.2f + random();
+            sceneLights.push_back(l);
+        }
+    }
+    ClusteredLights clusters = createClusteredLights();
+    double lightAssignMs = 0.0;
+
+    RenderTarget offscreen = {};
+    if (headless) {
+        offscreen = createRenderTarget(options.width, options.height);
+        bindRenderTarget(offscreen);
+    }
+    // Scaled rendering draws the scene into the bottom-left corner of full-size transient
+    // targets and upscales that corner into the window or headless target with a linear blit.
+    bool scaledRendering = options.resolutionBudgetMs > 0.f || options.renderScale < 1.f;
+    GLuint outputFbo = offscreen.fbo;
+    FrameGraph frameGraph;
+    FrameGraphTargets graphTargets;
+    ResolutionController resolution = createResolutionController(options.resolutionBudgetMs, options.renderScale,
+                                                                 std::min(options.minRenderScale, options.renderScale), 1.f);
+    uint64_t resolutionSamples = 0;
+    double scaleSum = 0.0;
+
+    GpuTimers gpuTimers = createGpuTimers();
+    const int frameScope = gpuTimerScope(gpuTimers, "frame");
+    const int clearScope = gpuTimerScope(gpuTimers, "clear");
+    const int prepassScope = gpuTimerScope(gpuTimers, "prepass");
+    const int drawScope = gpuTimerScope(gpuTimers, "draws");
+    const int upscaleScope = scaledRendering ? gpuTimerScope(gpuTimers, "upscale") : -1;
+
+    // Key slots for the two VAOs the queue can see.
+    const uint32_t poolVaoSlot = 0, instanceVaoSlot = 1;
+    RenderQueue queue, depthQueue;
+    DepthPrepass prepass = createDepthPrepass(options.prepass);
+    double queueBuildMs = 0.0, queueSortMs = 0.0, queueSubmitMs = 0.0;
+
+    uint64_t framesDrawn = 0;
+    resetGLStateCounters();
+    // The simulation half of a frame: camera, animation and light positions, written into a
+    // packet that the render half only reads.
+    auto simulateFrame = [&](FramePacket& packet, float time) {
+        packet.time = time;
+        // A minimized window reports 0x0, which no projection or render target can use.
+        packet.framebufferWidth = options.width;
+        packet.framebufferHeight = options.height;
+        if (window) glfwGetFramebufferSize(window, &packet.framebufferWidth, &packet.framebufferHeight);
+        packet.framebufferWidth = std::max(1, packet.framebufferWidth);
+        packet.framebufferHeight = std::max(1, packet.framebufferHeight);
+        packet.frame = FrameUniforms{};
+        packet.view = setupSceneView(packet.frame, options.draws > 0 ? options.draws : instanceCount, instanceSpacing,
+                                     (float)packet.framebufferWidth / packet.framebufferHeight);
+        mat4_rotate_y(packet.model, time * 0.5f);
+        float c = cosf(time * 0.3f), s = sinf(time * 0.3f);
+        packet.lights = sceneLights;
+        for (PointLight& l : packet.lights) {
+            float x = l.position[0], z = l.position[2];
+            l.position[0] = c * x + s * z;
+            l.position[2] = c * z - s * x;
+        }
+    };
+    auto renderFrame = [&](const FramePacket& packet) {
+        if (uploader) {
+            arrivedMeshes.clear();
+            pollMeshUploads(uploader, pool, arrivedMeshes);
+            for (const ReadyMesh& arrived : arrivedMeshes) {
+                uint32_t index = (uint32_t)arrived.id;
+                sceneMeshes[index] = arrived.mesh;
+                if (arrived.handle == NO_MESH) {
+                    std::cerr << "No room in the mesh pool for " << options.meshes[index] << std::endl;
+                    continue;
+                }
+                sceneRanges[index] = meshRange(pool, arrived.handle);
+                float radius = computeMeshBounds(arrived.mesh).radius;
+                parallelForQuery(jobs, sceneQuery, [&](const EcsView& view) {
+                    const MeshRef* meshRefs = (const MeshRef*)ecsArray(view, ECS_MESH);
+                    Bounds* bounds = (Bounds*)ecsArray(view, ECS_BOUNDS);
+                    for (uint32_t row = 0; row < view.count; ++row) {
+                        if (meshRefs[row].mesh != index) continue;
+                        bounds[row].radius = radius;
+                        sceneSpheres.radius[view.first + row] = radius;
+                    }
+                });
+                printf("Loaded %s: %u vertices, staged in %.2f ms on the upload thread, drawn %.1f ms after startup\n",
+                       options.meshes[index].c_str(), arrived.mesh.vertexCount, arrived.stageMs, (nowSeconds() - loadStart) * 1000.0);
+            }
+        }
+        ++framesDrawn;
+        gpuTimersBeginFrame(gpuTimers);
+        gpuTimerBegin(gpuTimers, frameScope);
+        // The output is the window's framebuffer at its current size, or the headless target.
+        int outputWidth = packet.framebufferWidth, outputHeight = packet.framebufferHeight;
+        int viewportWidth = outputWidth, viewportHeight = outputHeight;
+        if (scaledRendering) {
+            viewportWidth = std::max(1, (int)(outputWidth * resolution.scale + 0.5f));
+            viewportHeight = std::max(1, (int)(outputHeight * resolution.scale + 0.5f));
+            scaleSum += resolution.scale;
+        }
+
+        FrameUniforms frame = packet.frame;
+        ObjectUniforms object = {};
+        const SceneView& view = packet.view;
+        float distance = view.distance, farPlane = view.farPlane;
+        memcpy(object.model, packet.model, sizeof(object.model));
+        // Clusters use the frame's own projection and viewport, which follow window resizes.
+        if (!packet.lights.empty()) {
+            double start = nowSeconds();
+            assignLights(clusters, packet.lights.data(), (uint32_t)packet.lights.size(), frame.view,
+                         view.fovy, view.aspect, view.zNear, farPlane, jobs);
+            lightAssignMs += (nowSeconds() - start) * 1000.0;
+        }
+        clusterFrameParams(clusters, viewportWidth, viewportHeight, frame.clusterScale);
+        bindClusteredLights(clusters);
 
+        const CullSpheres& spheres = options.draws > 0 ? sceneSpheres : instanceSpheres;
+        uint32_t visibleCount = cullCount(spheres);
+        visible.resize(visibleCount);
+        if (options.cull) {
+            float viewProjection[16];
+            mat4_mul(viewProjection, frame.projection, frame.view);
+            Frustum frustum;
+            extractFrustumPlanes(frustum, viewProjection);
+            visibleCount = cullSpheres(frustum, spheres, visible.data(), jobs);
+        } else {
+            for (uint32_t i = 0; i < visibleCount; ++i) visible[i] = i;
+        }
+        if (options.occlusion) {
+            // The objects nearest the camera act as occluders for everything else.
+            auto cameraDistance = [&](uint32_t i) {
+                float dx = spheres.x[i], dy = spheres.y[i], dz = spheres.z[i] - distance;
+                return dx * dx + dy * dy + dz * dz;
+            };
+            occluders.assign(visible.begin(), visible.begin() + visibleCount);
+            size_t occluderCount = std::min<size_t>(occluders.size(), 32);
+            std::partial_sort(occluders.begin(), occluders.begin() + occluderCount, occluders.end(),
+                              [&](uint32_t a, uint32_t b) { return cameraDistance(a) < cameraDistance(b); });
+
+            float viewProjection[16], model[16];
+            mat4_mul(viewProjection, frame.projection, frame.view);
+            beginOcclusionFrame(occlusion, viewProjection);
+            for (size_t i = 0; i < occluderCount; ++i) {
+                uint32_t o = occluders[i];
+                const Mesh* occluderMesh = &mesh;
+                const float* transform = &instanceMatrices[(size_t)o * 16];
+                if (options.draws > 0) {
+                    uint32_t v, row;
+                    locateQueryRow(sceneQuery, o, &v, &row);
+                    transform = ((const Transform*)ecsArray(sceneQuery.views[v], ECS_TRANSFORM))[row].model;
+                    occluderMesh = &sceneMeshes[((const MeshRef*)ecsArray(sceneQuery.views[v], ECS_MESH))[row].mesh];
+                }
+                mat4_mul(model, transform, object.model);
+                addOccluder(occlusion, *occluderMesh, model);
+            }
+            rasterizeOccluders(occlusion, jobs);
+            buildDepthPyramid(occlusion);
+            visibleCount = cullOccludedSpheres(occlusion, spheres, visible.data(), visibleCount, jobs);
+        }
+
+        // Scene objects become one queue item each; the instanced grid is a single item.
+        double start = nowSeconds();
+        clearRenderQueue(queue);
+        if (options.draws > 0) {
+            DrawItem* items = pushDrawItems(queue, visibleCount);
+            parallelFor(jobs, visibleCount, 4096, [&](uint32_t begin, uint32_t end) {
+                // visible is in query order, so after one search per chunk the view only
+                // moves forward.
+                uint32_t v, row;
+                locateQueryRow(sceneQuery, visible[begin], &v, &row);
+                for (uint32_t i = begin; i < end; ++i) {
+                    uint32_t o = visible[i];
+                    while (o >= sceneQuery.views[v].first + sceneQuery.views[v].count) ++v;
+                    const EcsView& view = sceneQuery.views[v];
+                    row = o - view.first;
+                    uint32_t textureSlot = ((const MaterialRef*)ecsArray(view, ECS_MATERIAL))[row].textureSlot;
+                    DrawItem& item = items[i];
+                    item.key = makeSortKey(0, 0, 0, textureSlot, poolVaoSlot, (distance - spheres.z[o]) / farPlane);
+                    item.program = sp;
+                    item.texture = textures[textureSlot];
+                    item.vao = batch.vao;
+                    item.batch = &batch;
+                    item.range = sceneRanges[((const MeshRef*)ecsArray(view, ECS_MESH))[row].mesh];
+                    item.instanceCount = 1;
+                    mat4_mul(item.model, ((const Transform*)ecsArray(view, ECS_TRANSFORM))[row].model, object.model);
+                }
+            });
+        } else if (visibleCount > 0) {
+            visibleInstances.resize((size_t)visibleCount * INSTANCE_FLOATS);
+            for (uint32_t i = 0; i < visibleCount; ++i)
+                memcpy(&visibleInstances[(size_t)i * INSTANCE_FLOATS], &instanceData[(size_t)visible[i] * INSTANCE_FLOATS],
+                       INSTANCE_FLOATS * sizeof(float));
+            uploadInstances(instances, visibleInstances.data(), visibleCount);
+            DrawItem& item = pushDrawItem(queue);
+            item.key = makeSortKey(0, 0, 0, 0, instanceVaoSlot, 0.f);
+            item.program = sp;
+            item.texture = texID;
+            item.vao = VAO;
+            item.batch = nullptr;
+            item.range = meshRange(pool, meshHandle);
+            item.instanceCount = instances.count;
+            memcpy(item.model, object.model, sizeof(item.model));
+        }
+        double built = nowSeconds();
+        sortRenderQueue(queue);
+        double sorted = nowSeconds();
+
+        uniformRingBeginFrame(uniforms);
+        uniformRingBindBlock(uniforms, FRAME_BLOCK_BINDING, &frame, sizeof(frame));
+        bool drawPrepass = beginPrepassFrame(prepass);
+        if (drawPrepass) {
+            // The prepass keeps the shading pass's keys, so it draws in the same order and
+            // its sample count is the overdraw the shading pass would have had.
+            clearRenderQueue(depthQueue);
+            DrawItem* depthItems = pushDrawItems(depthQueue, (uint32_t)queue.items.size());
+            parallelFor(jobs, (uint32_t)queue.items.size(), 4096, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i) {
+                    DrawItem& item = depthItems[i];
+                    item = queue.items[i];
+                    item.program = depthProgram;
+                    item.texture = 0;
+                    item.vao = item.batch ? depthBatch.vao : depthVAO;
+                    if (item.batch) item.batch = &depthBatch;
+                }
+            });
+            depthQueue.order = queue.order;
+        }
+
+        // The scene draws straight into the output, or into transient targets that the
+        // upscale pass blits to the output.
+        clearFrameGraph(frameGraph);
+        FrameGraphTextureDesc outputDesc = { outputWidth, outputHeight, FRAME_GRAPH_RGBA8 };
+        uint32_t output = importFrameGraphTarget(frameGraph, "output", outputDesc, outputFbo);
+        std::vector<uint32_t> sceneTargets = { output };
+        if (scaledRendering)
+            sceneTargets = { createFrameGraphTexture(frameGraph, "scene color", outputDesc),
+                             createFrameGraphTexture(frameGraph, "scene depth", { outputWidth, outputHeight, FRAME_GRAPH_DEPTH24 }) };
+        uint32_t scenePass = addFrameGraphPass(frameGraph, "scene", {}, sceneTargets, [&] {
+            if (scaledRendering) glViewport(0, 0, viewportWidth, viewportHeight);
+            gpuTimerBegin(gpuTimers, clearScope);
+            cachedClearColor(0.1f, 0.1f, 0.1f, 1.f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cachedEnable(GL_DEPTH_TEST, true);
+            gpuTimerEnd(gpuTimers, clearScope);
+            if (drawPrepass) {
+                gpuTimerBegin(gpuTimers, prepassScope);
+                cachedColorMask(false);
+                beginPrepassQuery(prepass, 0);
+                submitRenderQueue(depthQueue, uniforms, jobs);
+                endPrepassQuery(prepass, 0);
+                cachedColorMask(true);
+                cachedDepthMask(false);
+                cachedDepthFunc(GL_LEQUAL);
+                gpuTimerEnd(gpuTimers, prepassScope);
+                beginPrepassQuery(prepass, 1);
+            }
+            gpuTimerBegin(gpuTimers, drawScope);
+            submitRenderQueue(queue, uniforms, jobs);
+            gpuTimerEnd(gpuTimers, drawScope);
+            if (drawPrepass) {
+                endPrepassQuery(prepass, 1);
+                cachedDepthMask(true);
+                cachedDepthFunc(GL_LESS);
+            }
+        });
+        if (scaledRendering) {
+            addFrameGraphPass(frameGraph, "upscale", { sceneTargets[0] }, { output }, [&] {
+                gpuTimerBegin(gpuTimers, upscaleScope);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, frameGraphFramebuffer(graphTargets, scenePass));
+                glBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+                glViewport(0, 0, outputWidth, outputHeight);
+                gpuTimerEnd(gpuTimers, upscaleScope);
+            });
+        }
+        compileFrameGraph(frameGraph);
+        executeFrameGraph(frameGraph, graphTargets);
+        queueBuildMs += (built - start) * 1000.0;
+        queueSortMs += (sorted - built) * 1000.0;
+        queueSubmitMs += (nowSeconds() - sorted) * 1000.0;
+        uniformRingEndFrame(uniforms);
+        gpuTimerEnd(gpuTimers, frameScope);
+        if (options.resolutionBudgetMs > 0.f && gpuTimers.sampleCount[frameScope] != resolutionSamples) {
+            resolutionSamples = gpuTimers.sampleCount[frameScope];
+            updateResolutionController(resolution, gpuTimerLatest(gpuTimers, frameScope));
+        }
+    };
+    // Frames on one thread simulate and render back to back through a single packet.
+    FramePacket framePacket = {};
+    auto drawFrame = [&](float time) {
+        simulateFrame(framePacket, time);
+        renderFrame(framePacket);
+    };
+
+    // --render-thread: this thread polls input and simulates while a render thread, which
+    // takes over the GL context, draws and presents each packet.
+    FrameQueue<FramePacket> packets;
+    auto makeContextCurrent = [&](bool current) {
+        if (window) glfwMakeContextCurrent(current ? window : NULL);
+        else makeHeadlessContextCurrent(headless, current);
+    };
+    auto runRenderThread = [&](uint64_t frames, const std::function<float(uint64_t)>& frameTime,
+                               const std::function<void(const FramePacket&)>& present) {
+        initFrameQueue(packets, options.renderThreadSlots);
+        // Latency is kept for the most recent frames only and reported every second, so
+        // an interactive session neither grows without bound nor waits until exit.
+        const size_t latencyWindow = 240;
+        std::vector<float> queuedMs, latencyMs;
+        uint64_t renderedFrames = 0;
+        double lastReport = nowSeconds();
+        // The resize callback calls GL, which this thread can no longer do.
+        if (window) glfwSetFramebufferSizeCallback(window, NULL);
+        makeContextCurrent(false);
+        std::thread renderThread([&] {
+            makeContextCurrent(true);
+            int width = 0, height = 0;
+            while (const FramePacket* packet = acquireFramePacket(packets)) {
+                double start = nowSeconds();
+                if (window && (packet->framebufferWidth != width || packet->framebufferHeight != height)) {
+                    width = packet->framebufferWidth;
+                    height = packet->framebufferHeight;
+                    glViewport(0, 0, width, height);
+                }
+                renderFrame(*packet);
+                present(*packet);
+                float queued = (float)((start - packet->publishedSeconds) * 1000.0);
+                float latency = (float)((nowSeconds() - packet->inputSeconds) * 1000.0);
+                if (queuedMs.size() < latencyWindow) {
+                    queuedMs.push_back(queued);
+                    latencyMs.push_back(latency);
+                } else {
+                    queuedMs[renderedFrames % latencyWindow] = queued;
+                    latencyMs[renderedFrames % latencyWindow] = latency;
+                }
+                ++renderedFrames;
+                if (nowSeconds() - lastReport >= 1.0) {
+                    lastReport = nowSeconds();
+                    TimeStats q = summarizeTimes(queuedMs), l = summarizeTimes(latencyMs);
+                    printf("Render thread, last %u frames: queued %.2f ms mean, input to present %.2f ms p50, %.2f ms p95\n",
+                           l.samples, q.meanMs, l.p50Ms, l.p95Ms);
+                }
+                releaseFramePacket(packets);
+            }
+            makeContextCurrent(false);
+        });
+        for (uint64_t i = 0; i < frames && !closeRequested(); ++i) {
+            FramePacket* packet = beginFramePacket(packets);
+            // Input is polled only once a slot is free, so it is as fresh as the queue allows.
+            if (window) {
+                glfwPollEvents();
+                processInput(window);
+            }
+            packet->index = i;
+            packet->inputSeconds = nowSeconds();
+            simulateFrame(*packet, frameTime(i));
+            packet->publishedSeconds = nowSeconds();
+            publishFramePacket(packets);
+        }
+        closeFrameQueue(packets);
+        renderThread.join();
+        makeContextCurrent(true);
+        if (window) glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+        // Queued is the latency the packet queue adds: how long a finished packet waited
+        // for the render thread. Input to present covers simulation, waiting and drawing.
+        TimeStats queued = summarizeTimes(queuedMs), latency = summarizeTimes(latencyMs);
+        printf("Render thread: %llu frames through %zu packet slots, latency over the last %u\n",
+               (unsigned long long)renderedFrames, packets.slots.size(), latency.samples);
+        printf("  %-18s %10s %10s %10s %10s\n", "latency", "mean ms", "p50 ms", "p95 ms", "max ms");
+        printf("  %-18s %10.3f %10.3f %10.3f %10.3f\n", "queued", queued.meanMs, queued.p50Ms, queued.p95Ms, queued.maxMs);
+        printf("  %-18s %10.3f %10.3f %10.3f %10.3f\n", "input to present", latency.meanMs, latency.p50Ms, latency.p95Ms, latency.maxMs);
+    };
+
+    if (options.benchInstances) {
+        // Double the instance count until the mean frame time crosses the budget.
+        setSwapInterval(0);
+        printf("%10s %12s %16s\n", "instances", "frame ms", "instances/s");
+        const int warmupFrames = 5, measuredFrames = 30;
+        for (uint32_t count = 1; !closeRequested(); count *= 2) {
+            setInstanceCount(count);
+            double total = 0.0;
+            for (int i = 0; i < warmupFrames + measuredFrames; ++i) {
+                double start = nowSeconds();
+                drawFrame((float)start);
+                glFinish();
+                if (i >= warmupFrames) total += nowSeconds() - start;
+                presentFrame();
+            }
+            double ms = total * 1000.0 / measuredFrames;
+            printf("%10u %12.3f %16.0f\n", count, ms, count / (ms / 1000.0));
+            if (ms > options.benchBudgetMs || count >= (1u << 24)) break;
+        }
+    }
+
+    if (options.benchQueue) {
+        setSwapInterval(0);
+        const int warmupFrames = 5, measuredFrames = 50;
+        double total = 0.0;
+        for (int i = 0; i < warmupFrames + measuredFrames && !closeRequested(); ++i) {
+            if (i == warmupFrames) queueBuildMs = queueSortMs = queueSubmitMs = 0.0;
+            double start = nowSeconds();
+            drawFrame((float)start);
+            glFinish();
+            if (i >= warmupFrames) total += nowSeconds() - start;
+            presentFrame();
+        }
+        printf("Render queue submission of %zu items over %d frames (%s, %u recording threads)\n", queue.items.size(),
+               measuredFrames, batch.indirect ? "multi-draw indirect" : "one draw per item", jobPoolThreadCount(jobs));
+        printf("  %-10s %8.3f ms\n", "build", queueBuildMs / measuredFrames);
+        printf("  %-10s %8.3f ms\n", "sort", queueSortMs / measuredFrames);
+        printf("  %-10s %8.3f ms  %u state changes\n", "submit", queueSubmitMs / measuredFrames, queue.stateChanges);
+        printf("  %-10s %8.3f ms\n", "frame", total * 1000.0 / measuredFrames);
+    }
+
+    if (options.benchStreamMB) {
+        // A wave grid regenerated every frame is uploaded through each strategy in turn and
+        // drawn, so the driver has to honour the GPU's reads of earlier frames' data.
+        setSwapInterval(0);
+        uint32_t side = std::max(2u, (uint32_t)sqrt(options.benchStreamMB * 1048576.0 / sizeof(Vertex)));
+        GLsizeiptr bytes = (GLsizeiptr)side * side * sizeof(Vertex);
+        std::vector<uint32_t> gridIndices;
+        for (uint32_t y = 0; y + 1 < side; ++y) {
+            for (uint32_t x = 0; x + 1 < side; ++x) {
+                uint32_t i = y * side + x;
+                gridIndices.insert(gridIndices.end(), { i, i + 1, i + side, i + 1, i + side + 1, i + side });
+            }
+        }
+        GLuint gridVao, gridEbo;
+        glGenVertexArrays(1, &gridVao);
+        glGenBuffers(1, &gridEbo);
+        cachedBindVertexArray(gridVao);
+        cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, gridIndices.size() * sizeof(uint32_t), gridIndices.data(), GL_STATIC_DRAW);
+        cachedBindVertexArray(0);
+        // The grid has no instance arrays, so the instance attributes read their identity generic values.
+        for (GLuint i = 0; i < 7; ++i) {
+            GLuint column = i < 4 ? i : i - 4;
+            glVertexAttrib4f(INSTANCE_MATRIX_LOCATION + i, column == 0 ? 1.f : 0.f, column == 1 ? 1.f : 0.f,
+                             column == 2 ? 1.f : 0.f, column == 3 ? 1.f : 0.f);
+        }
+
+        enum Strategy { BUFFER_DATA, BUFFER_SUB_DATA, MAP_SYNCHRONIZED, ORPHAN_MAP, PERSISTENT };
+        const char* names[] = { "glBufferData", "glBufferSubData", "map (synchronized)", "orphan + map", "persistent ring" };
+        std::vector<Vertex> staging((size_t)side * side);
+        const int warmupFrames = 10, measuredFrames = 60;
+        printf("Streaming %.2f MB of vertices per frame (%u x %u grid) over %d frames\n", bytes / 1048576.0, side, side, measuredFrames);
+        printf("%-20s %12s %12s %12s %12s\n", "strategy", "upload ms", "max ms", "upload MB/s", "frame ms");
+        for (int strategy = BUFFER_DATA; strategy <= PERSISTENT; ++strategy) {
+            if (closeRequested()) break;
+            if (strategy == PERSISTENT && !GLExt.bufferStorage) {
+                printf("%-20s %12s\n", names[strategy], "unsupported");
+                continue;
+            }
+            GLuint vbo = 0;
+            StreamBuffer stream = {};
+            if (strategy >= ORPHAN_MAP) {
+                stream = createStreamBuffer(GL_ARRAY_BUFFER, bytes, strategy == PERSISTENT);
+            } else {
+                glGenBuffers(1, &vbo);
+                cachedBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            }
+            std::vector<float> uploadMs;
+            double measureStart = 0.0;
+            for (int i = 0; i < warmupFrames + measuredFrames && !closeRequested(); ++i) {
+                if (i == warmupFrames) {
+                    glFinish();
+                    measureStart = nowSeconds();
+                }
+                float time = (float)(i * (1.0 / 60.0));
+                // Every strategy gets the grid from staging, so upload time covers the same
+                // work for all of them: the copy into GL memory plus the GL calls and waits.
+                writeWaveGrid(staging.data(), side, time);
+                GLuint source = vbo;
+                GLintptr offset = 0;
+                double start = nowSeconds();
+                if (strategy >= ORPHAN_MAP) {
+                    streamBufferBeginFrame(stream);
+                    StreamAllocation a = streamAlloc(stream, bytes);
+                    memcpy(a.data, staging.data(), (size_t)bytes);
+                    streamBufferUnmap(stream);
+                    source = stream.buffer;
+                    offset = a.offset;
+                } else {
+                    cachedBindBuffer(GL_ARRAY_BUFFER, vbo);
+                    if (strategy == BUFFER_DATA) {
+                        glBufferData(GL_ARRAY_BUFFER, bytes, staging.data(), GL_STREAM_DRAW);
+                    } else if (strategy == BUFFER_SUB_DATA) {
+                        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staging.data());
+                    } else {
+                        void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT);
+                        memcpy(mapped, staging.data(), (size_t)bytes);
+                        glUnmapBuffer(GL_ARRAY_BUFFER);
+                    }
+                }
+                double upload = (nowSeconds() - start) * 1000.0;
+                if (i >= warmupFrames) uploadMs.push_back((float)upload);
+
+                cachedClearColor(0.1f, 0.1f, 0.1f, 1.f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                cachedEnable(GL_DEPTH_TEST, true);
+                FrameUniforms frame = {};
+                ObjectUniforms object = {};
+                setupSceneView(frame, 1, instanceSpacing, (float)options.width / options.height);
+                // Tilt the grid back about x so the overhead light reaches it.
+                mat4_identity(object.model);
+                object.model[5] = object.model[10] = cosf(-0.9f);
+                object.model[6] = sinf(-0.9f);
+                object.model[9] = -sinf(-0.9f);
+                mat4_normal_matrix(object.normalMatrix, object.model);
+                uniformRingBeginFrame(uniforms);
+                uniformRingBindBlock(uniforms, FRAME_BLOCK_BINDING, &frame, sizeof(frame));
+                uniformRingBindBlock(uniforms, OBJECT_BLOCK_BINDING, &object, sizeof(object));
+                cachedUseProgram(sp);
+                cachedBindTexture(0, GL_TEXTURE_2D, texID);
+                cachedBindVertexArray(gridVao);
+                cachedBindBuffer(GL_ARRAY_BUFFER, source);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, position)));
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, normal)));
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offset + offsetof(Vertex, texcoords)));
+                for (GLuint attribute = 0; attribute < 3; ++attribute) glEnableVertexAttribArray(attribute);
+                glDrawElements(GL_TRIANGLES, (GLsizei)gridIndices.size(), GL_UNSIGNED_INT, nullptr);
+                if (strategy >= ORPHAN_MAP) streamBufferEndFrame(stream);
+                uniformRingEndFrame(uniforms);
+                presentFrame();
+            }
+            glFinish();
+            if (uploadMs.size() == measuredFrames) {
+                double frameMs = (nowSeconds() - measureStart) * 1000.0 / measuredFrames;
+                TimeStats upload = summarizeTimes(uploadMs);
+                double rate = upload.meanMs > 0.0 ? bytes / 1048576.0 / (upload.meanMs / 1000.0) : 0.0;
+                printf("%-20s %12.3f %12.3f %12.0f %12.3f\n", names[strategy], upload.meanMs, upload.maxMs, rate, frameMs);
+            }
+            if (vbo) cachedDeleteBuffers(1, &vbo);
+            if (stream.buffer) freeStreamBuffer(stream);
+        }
+        cachedDeleteVertexArrays(1, &gridVao);
+        cachedDeleteBuffers(1, &gridEbo);
+    }
+
+    if (options.benchArena) {
+        // Loads N synthetic meshes into a pool that fits them exactly, unloads a random
+        // half, then compares the free space before and after compaction and reads the
+        // surviving meshes back to check that compaction moved them intact.
+        uint32_t seed = 7;
+        auto random = [&] { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+        std::vector<Mesh> meshes(options.benchArena);
+        uint32_t vertexTotal = 0, indexTotal = 0;
+        for (Mesh& m : meshes) {
+            m.vertexCount = 16 + random() % 512;
+            m.indexCount = 3 * (m.vertexCount + random() % m.vertexCount);
+            m.vertices = new Vertex[m.vertexCount];
+            m.indices = new uint32_t[m.indexCount];
+            for (uint32_t i = 0; i < m.vertexCount; ++i)
+                m.vertices[i] = { { (float)random(), (float)random(), (float)random() }, { 0.f, 1.f, 0.f }, { (float)i, 0.f } };
+            for (uint32_t i = 0; i < m.indexCount; ++i) m.indices[i] = random() % m.vertexCount;
+            vertexTotal += m.vertexCount;
+            indexTotal += m.indexCount;
+        }
+        MeshPool arena = createMeshPool(vertexTotal, indexTotal);
+        glFinish();
+        double start = nowSeconds();
+        std::vector<MeshHandle> handles;
+        for (const Mesh& m : meshes) handles.push_back(addMeshToPool(arena, m));
+        glFinish();
+        double loadMs = (nowSeconds() - start) * 1000.0;
+
+        std::vector<uint32_t> order(meshes.size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        for (uint32_t i = (uint32_t)order.size(); i > 1; --i) std::swap(order[i - 1], order[random() % i]);
+        std::vector<bool> loaded(meshes.size(), true);
+        start = nowSeconds();
+        for (uint32_t i = 0; i < order.size() / 2; ++i) {
+            removeMeshFromPool(arena, handles[order[i]]);
+            loaded[order[i]] = false;
+        }
+        double unloadMs = (nowSeconds() - start) * 1000.0;
+
+        // A mesh a quarter of the pool's size stands in for a large streamed-in asset.
+        Mesh large = {};
+        large.vertexCount = vertexTotal / 4;
+        large.indexCount = indexTotal / 4;
+        large.vertices = new Vertex[large.vertexCount]();
+        large.indices = new uint32_t[large.indexCount]();
+        auto tryLarge = [&] {
+            try {
+                removeMeshFromPool(arena, addMeshToPool(arena, large));
+                return "fits";
+            } catch (const std::runtime_error&) {
+                return "does not fit";
+            }
+        };
+        auto printStats = [&](const char* label) {
+            MeshPoolStats stats = meshPoolStats(arena);
+            printf("  %-18s vertices %9u free, largest block %9u (%5.1f%% fragmented); indices %9u free, largest block %9u (%5.1f%% fragmented); large mesh %s\n",
+                   label, stats.vertices.totalFree, stats.vertices.largestFree,
+                   100.0 * (1.0 - (double)stats.vertices.largestFree / std::max(1u, stats.vertices.totalFree)),
+                   stats.indices.totalFree, stats.indices.largestFree,
+                   100.0 * (1.0 - (double)stats.indices.largestFree / std::max(1u, stats.indices.totalFree)), tryLarge());
+        };
+        printf("Mesh arena of %zu meshes: %u vertices (%.1f MB), %u indices (%.1f MB)\n", meshes.size(), vertexTotal,
+               vertexTotal * (sizeof(Vertex) + sizeof(vec3)) / 1048576.0, indexTotal, indexTotal * sizeof(uint32_t) / 1048576.0);
+        printf("  %-18s %9.3f ms\n", "load", loadMs);
+        printf("  %-18s %9.3f ms\n", "unload half", unloadMs);
+        printStats("before compaction");
+        glFinish();
+        start = nowSeconds();
+        compactMeshPool(arena);
+        double compactCpuMs = (nowSeconds() - start) * 1000.0;
+        glFinish();
+        double compactMs = (nowSeconds() - start) * 1000.0;
+        printf("  %-18s %9.3f ms (%.3f ms CPU)\n", "compact", compactMs, compactCpuMs);
+        printStats("after compaction");
+
+        uint32_t mismatches = 0;
+        std::vector<Vertex> vertices;
+        std::vector<vec3> positions;
+        std::vector<uint32_t> indices;
+        for (uint32_t i = 0; i < meshes.size(); ++i) {
+            if (!loaded[i]) continue;
+            const Mesh& m = meshes[i];
+            const MeshRange& range = meshRange(arena, handles[i]);
+            vertices.resize(m.vertexCount);
+            positions.resize(m.vertexCount);
+            indices.resize(m.indexCount);
+            cachedBindBuffer(GL_COPY_READ_BUFFER, arena.vbo);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range.baseVertex * sizeof(Vertex), m.vertexCount * sizeof(Vertex), vertices.data());
+            cachedBindBuffer(GL_COPY_READ_BUFFER, arena.positionVbo);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range.baseVertex * sizeof(vec3), m.vertexCount * sizeof(vec3), positions.data());
+            cachedBindBuffer(GL_COPY_READ_BUFFER, arena.ebo);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range.firstIndex * sizeof(uint32_t), m.indexCount * sizeof(uint32_t), indices.data());
+            bool same = !memcmp(vertices.data(), m.vertices, m.vertexCount * sizeof(Vertex)) &&
+                        !memcmp(indices.data(), m.indices, m.indexCount * sizeof(uint32_t));
+            for (uint32_t v = 0; v < m.vertexCount && same; ++v) same = !memcmp(&positions[v], &m.vertices[v].position, sizeof(vec3));
+            mismatches += !same;
+        }
+        cachedBindBuffer(GL_COPY_READ_BUFFER, 0);
+        printf("  %-18s %u of %zu meshes differ after compaction\n", "readback", mismatches, meshes.size() - order.size() / 2);
+        freeMeshPool(arena);
+        freeMesh(large);
+        for (Mesh& m : meshes) freeMesh(m);
+    }
+
+    // Benchmark runs and headless frames advance animation time a fixed 1/60 s per frame,
+    // so every run renders the same frames.
+    const double timeStep = 1.0 / 60.0;
+    if (!options.benchRunPath.empty()) {
+        if (options.swapInterval < 0) setSwapInterval(0);
+        uint32_t frames = options.benchFrames ? options.benchFrames : options.benchSeconds > 0.f ? UINT32_MAX : 1000;
+        std::vector<float> cpuFrameMs;
+        double measureStart = 0.0;
+        for (uint64_t i = 0; !closeRequested(); ++i) {
+            if (i == options.warmupFrames) {
+                gpuTimersRecord(gpuTimers, true);
+                measureStart = nowSeconds();
+            }
+            double start = nowSeconds();
+            drawFrame((float)(i * timeStep));
+            presentFrame();
+            if (i < options.warmupFrames) continue;
+            cpuFrameMs.push_back((float)((nowSeconds() - start) * 1000.0));
+            if (cpuFrameMs.size() >= frames) break;
+            if (options.benchSeconds > 0.f && nowSeconds() - measureStart >= options.benchSeconds) break;
+        }
+        double seconds = nowSeconds() - measureStart;
+        gpuTimersFlush(gpuTimers);
+
+        TimeStats cpu = summarizeTimes(cpuFrameMs);
+        TimeStats gpu = summarizeTimes(gpuTimers.recorded[frameScope]);
+        printf("%-10s %8s %10s %10s %10s %10s %10s\n", "frame", "samples", "mean ms", "p50 ms", "p95 ms", "p99 ms", "max ms");
+        printf("%-10s %8u %10.3f %10.3f %10.3f %10.3f %10.3f\n", "cpu", cpu.samples, cpu.meanMs, cpu.p50Ms, cpu.p95Ms, cpu.p99Ms, cpu.maxMs);
+        printf("%-10s %8u %10.3f %10.3f %10.3f %10.3f %10.3f\n", "gpu", gpu.samples, gpu.meanMs, gpu.p50Ms, gpu.p95Ms, gpu.p99Ms, gpu.maxMs);
+
+        auto escape = [](const char* text) {
+            std::string out;
+            for (const char* c = text; c && *c; ++c) {
+                if (*c == '"' || *c == '\\') out += '\\';
+                out += *c;
+            }
+            return out;
+        };
+        std::ofstream json(options.benchRunPath);
+        json << "{\n  \"renderer\": \"" << escape((const char*)glGetString(GL_RENDERER)) << "\",\n"
+             << "  \"gl_version\": \"" << escape((const char*)glGetString(GL_VERSION)) << "\",\n"
+             << "  \"instances\": " << options.instances << ",\n  \"draws\": " << options.draws << ",\n"
+             << "  \"lights\": " << options.lights << ",\n"
+             << "  \"mean_render_scale\": " << (scaledRendering ? scaleSum / framesDrawn : 1.0) << ",\n"
+             << "  \"swap_interval\": " << std::max(options.swapInterval, 0) << ",\n"
+             << "  \"warmup_frames\": " << options.warmupFrames << ",\n  \"time_step_s\": " << timeStep << ",\n"
+             << "  \"seconds\": " << seconds << ",\n"
+             << "  \"cpu_frame\": " << timeStatsJson(cpu) << ",\n"
+             << "  \"gpu_frame\": " << timeStatsJson(gpu) << ",\n  \"gpu_scopes\": {";
+        for (size_t scope = 0; scope < gpuTimers.names.size(); ++scope)
+            json << (scope ? ",\n" : "\n") << "    \"" << gpuTimers.names[scope] << "\": " << timeStatsJson(summarizeTimes(gpuTimers.recorded[scope]));
+        json << "\n  },\n  \"gpu_dropped\": " << gpuTimers.dropped << "\n}\n";
+        if (!json) std::cerr << "Failed to write " << options.benchRunPath << std::endl;
+    }
+
+    bool benchmarking = options.benchInstances || options.benchQueue || options.benchStreamMB || options.benchArena || !options.benchRunPath.empty();
+    if (options.headless && !benchmarking) {
+        uint32_t frames = options.benchFrames ? options.benchFrames : 1;
+        std::vector<uint8_t> pixels;
+        auto writeFrame = [&](uint64_t i) {
+            readRenderTarget(offscreen, pixels);
+            std::string path = framePath(options.outputPattern, (uint32_t)i);
+            if (!writeImage(path.c_str(), offscreen.width, offscreen.height, pixels.data()))
+                std::cerr << "Failed to write " << path << std::endl;
+        };
+        if (options.renderThreadSlots) {
+            runRenderThread(frames, [&](uint64_t i) { return (float)(i * timeStep); },
+                            [&](const FramePacket& packet) { writeFrame(packet.index); });
+        } else {
+            for (uint32_t i = 0; i < frames; ++i) {
+                drawFrame((float)(i * timeStep));
+                writeFrame(i);
+            }
+        }
+        printf("Wrote %u %dx%d frames to %s\n", frames, offscreen.width, offscreen.height, options.outputPattern.c_str());
+    }
+
+    if (!options.headless && !benchmarking && options.renderThreadSlots)
+        runRenderThread(UINT64_MAX, [&](uint64_t) { return (float)glfwGetTime(); },
+                        [&](const FramePacket&) { glfwSwapBuffers(window); });
+    while (!options.headless && !benchmarking && !options.renderThreadSlots && !closeRequested()) {
+        processInput(window);
+        drawFrame((float)glfwGetTime());
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteBuffers(1, &VBO); glDeleteBuffers(1, &EBO);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteProgram(sp);
+    if (uploader) {
+        // The loader may be waiting for room that only the render loop would have made.
+        stopMeshUploader(uploader);
+        loaderThread.join();
+        freeMeshUploader(uploader);
+        if (uploadWindow) glfwDestroyWindow(uploadWindow);
+        destroyHeadlessContext(uploadContext);
+    }
+    if (options.draws > 0) {
+        freeDrawBatch(batch);
+        freeDrawBatch(depthBatch);
+    }
+    freeEcsWorld(scene);
+    freeMeshPool(pool);
+    for (Mesh& sceneMesh : sceneMeshes) freeMesh(sceneMesh);
+    freeInstanceBuffer(instances);
+    cachedDeleteVertexArrays(1, &VAO); cachedDeleteVertexArrays(1, &depthVAO);
+    cachedDeleteProgram(sp);
+    cachedDeleteProgram(depthProgram);
+    cachedDeleteTextures((GLsizei)textures.size(), textures.data());
+    if (!options.gpuTimingsPath.empty()) {
+        printf("%-10s %8s %10s %10s %10s %10s %10s\n", "gpu scope", "samples", "mean ms", "p50 ms", "p95 ms", "p99 ms", "max ms");
+        for (const GpuTimerStats& s : gpuTimerStats(gpuTimers))
+            printf("%-10s %8u %10.3f %10.3f %10.3f %10.3f %10.3f\n", s.name.c_str(), s.samples, s.meanMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs);
+        if (!writeGpuTimersJson(gpuTimers, options.gpuTimingsPath.c_str()))
+            std::cerr << "Failed to write " << options.gpuTimingsPath << std::endl;
+    }
+    if (!sceneLights.empty() && framesDrawn > 0) {
+        printf("Clustered lighting: %zu lights, assignment %.3f ms per frame, %zu light indices, up to %u lights per cluster\n",
+               sceneLights.size(), lightAssignMs / framesDrawn, clusters.indices.size(), clusters.maxClusterLights);
+    }
+    freeClusteredLights(clusters);
+    if (framesDrawn > 0 && prepass.prepassFrames > 0) {
+        printf("Depth prepass: drawn on %llu of %llu frames, last measured overdraw %.2f\n",
+               (unsigned long long)prepass.prepassFrames, (unsigned long long)framesDrawn, prepass.overdraw);
+    }
+    freeDepthPrepass(prepass);
+    if (scaledRendering && framesDrawn > 0) {
+        printf("Render scale: %.3f at exit, %.3f on average, %u changes\n", resolution.scale, scaleSum / framesDrawn, resolution.changes);
+    }
+    freeFrameGraphTargets(graphTargets);
+    if (options.stateStats && framesDrawn > 0) {
+        printf("GL state calls over %llu frames: %llu issued, %llu filtered (%.1f issued, %.1f filtered per frame)\n",
+               (unsigned long long)framesDrawn, (unsigned long long)GLState.issued, (unsigned long long)GLState.filtered,
+               (double)GLState.issued / framesDrawn, (double)GLState.filtered / framesDrawn);
+    }
+    freeGpuTimers(gpuTimers);
+    freeUniformRing(uniforms);
     freeMesh(mesh);
-    glfwTerminate();
+    freeJobPool(jobs);
+    if (headless) {
+        freeRenderTarget(offscreen);
+        destroyHeadlessContext(headless);
+    } else {
+        glfwTerminate();
+    }
     return 0;
 }
 
-void framebuffer_size_callback(GLFWwindow*, int w, int h) { glViewport(0, 0, w, h); }
-void processInput(GLFWwindow* window) {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+// --instances N              draw N copies of the mesh in a grid
+// --draws N                  draw N objects as separate commands of one multi-draw
+// --lights N                 add N point lights, shaded through clustered forward lighting
+// --mesh path                add an OBJ to the --draws scene (repeatable, defaults to cube.obj)
+// --async-load               load and upload the --mesh files on background threads while frames are drawn
+// --no-cull                  submit every object without frustum culling
+// --prepass on|off|auto      depth-only prepass before shading; auto enables it while measured overdraw is high (default auto)
+// --occlusion                also cull objects hidden behind the nearest objects (CPU depth buffer)
+// --gpu-timings file.json    print per-scope GPU times on exit and write them as JSON
+// --state-stats              print how many GL state calls the state cache issued and filtered
+// --shader-cache dir         directory for cached program binaries (default shader_cache)
+// --no-shader-cache          always compile the shaders from source
+// --bench-run file.json      render a fixed frame sequence and write CPU/GPU frame time percentiles as JSON
+// --frames N                 measured frames for --bench-run (default 1000)
+// --duration s               stop --bench-run after s seconds of measured frames
+// --warmup N                 frames rendered before --bench-run starts measuring (default 60)
+// --headless                 render without a window into an offscreen target and write --frames images (default 1)
+// --output pattern           image path for --headless; # runs become the frame number (default frame_####.tga)
+// --render-scale s           render the scene at s times the output size and upscale it (starting scale with --dynamic-res)
+// --dynamic-res [ms]         adjust the render scale to keep GPU frame time within a budget (default 16.7)
+// --min-scale s              lowest scale --dynamic-res may pick (default 0.5)
+// --size WxH                 window or offscreen size (default 800x600)
+// --swap-interval N          glfwSwapInterval value; 0 uncaps the frame rate (--bench-run defaults to 0)
+// --render-thread [N]        simulate on the main thread and render on another, through N packet slots (default 2)
+// --software                 render --frames images (default 1) on the CPU rasterizer without GL and report its throughput
+// --threads N                threads for parallel work, including the main thread (default one per hardware thread)
+// --pin-threads              pin each worker thread to its own CPU (Linux)
+// --bench-instances [ms]     grow the instance count until a frame exceeds the budget
+// --bench-cull [N]           time frustum culling of N bounds (default 1M) without a window
+// --bench-occlusion [N]      time occluder rasterization and testing of N boxes (default 100K)
+// --bench-matrix [N]         time scalar against SIMD matrix math over N matrices (default 1M) without a window
+// --bench-frame-graph [N]    compile a random frame graph of N passes, check the schedule and report aliasing (default 200) without a window
+// --bench-scene [N]          time full and incremental transform updates of an N-node scene graph (default 1M) without a window
+// --bench-ecs [N]            create, churn and query N entities, checking every component and query count (default 100K) without a window
+// --bench-jobs [N]           time the job system on 1 to N threads, doubling each step (default 64), without a window
+// --bench-stream [MB]        compare per-frame vertex upload strategies streaming MB per frame (default 8)
+// --bench-arena [N]          load N meshes into a pool, unload half and time compaction (default 4096)
+// --bench-queue [N]          time sorting N render queue items, then building, sorting and submitting them per frame (default 100K)
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+        if (arg == "--instances" && hasValue) options.instances = (uint32_t)std::max(1, atoi(argv[++i]));
+        else if (arg == "--draws" && hasValue) options.draws = (uint32_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--lights" && hasValue) options.lights = (uint32_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--mesh" && hasValue) options.meshes.push_back(argv[++i]);
+        else if (arg == "--async-load") options.asyncLoad = true;
+        else if (arg == "--no-cull") options.cull = false;
+        else if (arg == "--prepass" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "on") options.prepass = PREPASS_ON;
+            else if (mode == "off") options.prepass = PREPASS_OFF;
+            else if (mode == "auto") options.prepass = PREPASS_AUTO;
+            else std::cerr << "Invalid prepass mode: " << mode << std::endl;
+        }
+        else if (arg == "--occlusion") options.occlusion = true;
+        else if (arg == "--bench-cull") options.benchCull = hasValue ? (uint32_t)atoi(argv[++i]) : 1000000;
+        else if (arg == "--bench-occlusion") options.benchOcclusion = hasValue ? (uint32_t)atoi(argv[++i]) : 100000;
+        else if (arg == "--bench-matrix") options.benchMatrix = hasValue ? (uint32_t)atoi(argv[++i]) : 1000000;
+        else if (arg == "--bench-frame-graph") options.benchFrameGraph = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 200;
+        else if (arg == "--bench-scene") options.benchScene = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 1000000;
+        else if (arg == "--bench-ecs") options.benchEcs = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 100000;
+        else if (arg == "--bench-jobs") options.benchJobs = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 64;
+        else if (arg == "--bench-stream") options.benchStreamMB = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 8;
+        else if (arg == "--bench-arena") options.benchArena = hasValue ? (uint32_t)std::max(1, atoi(argv[++i])) : 4096;
+        else if (arg == "--bench-queue") options.benchQueue = hasValue ? (uint32_t)atoi(argv[++i]) : 100000;
+        else if (arg == "--gpu-timings" && hasValue) options.gpuTimingsPath = argv[++i];
+        else if (arg == "--state-stats") options.stateStats = true;
+        else if (arg == "--shader-cache" && hasValue) options.shaderCacheDir = argv[++i];
+        else if (arg == "--no-shader-cache") options.shaderCacheDir.clear();
+        else if (arg == "--bench-run" && hasValue) options.benchRunPath = argv[++i];
+        else if (arg == "--frames" && hasValue) options.benchFrames = (uint32_t)std::max(1, atoi(argv[++i]));
+        else if (arg == "--duration" && hasValue) options.benchSeconds = (float)atof(argv[++i]);
+        else if (arg == "--warmup" && hasValue) options.warmupFrames = (uint32_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--headless") options.headless = true;
+        else if (arg == "--software") options.software = true;
+        else if (arg == "--threads" && hasValue) options.threads = (uint32_t)std::max(1, atoi(argv[++i]));
+        else if (arg == "--pin-threads") options.pinThreads = true;
+        else if (arg == "--render-thread") options.renderThreadSlots = hasValue ? (uint32_t)std::min(std::max(2, atoi(argv[++i])), 8) : 2;
+        else if (arg == "--output" && hasValue) options.outputPattern = argv[++i];
+        else if (arg == "--size" && hasValue) {
+            int w = 0, h = 0;
+            if (sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) { options.width = w; options.height = h; }
+            else std::cerr << "Invalid size: " << argv[i] << std::endl;
+        }
+        else if (arg == "--render-scale" && hasValue) options.renderScale = std::min(std::max((float)atof(argv[++i]), 0.1f), 1.f);
+        else if (arg == "--dynamic-res") options.resolutionBudgetMs = hasValue ? (float)atof(argv[++i]) : 16.7f;
+        else if (arg == "--min-scale" && hasValue) options.minRenderScale = std::min(std::max((float)atof(argv[++i]), 0.1f), 1.f);
+        else if (arg == "--swap-interval" && hasValue) options.swapInterval = std::max(0, atoi(argv[++i]));
+        else if (arg == "--bench-instances") {
+            options.benchInstances = true;
+            if (hasValue) options.benchBudgetMs = (float)atof(argv[++i]);
+        }
+        else std::cerr << "Unknown option: " << arg << std::endl;
+    }
+    return options;
 }
 
-void freeMesh(Mesh& mesh) {
-    delete[] mesh.vertices;
-    delete[] mesh.indices;
-    mesh.vertices = nullptr; mesh.indices = nullptr;
-    mesh.vertexCount = mesh.indexCount = 0;
+SceneView setupSceneView(FrameUniforms& frame, uint32_t objectCount, float spacing, float aspect) {
+    SceneView view;
+    view.radius = instanceGridRadius(objectCount, spacing);
+    view.distance = 6.f + 2.7f * view.radius;
+    view.fovy = 3.1415926f / 4.f;
+    view.aspect = aspect;
+    view.zNear = 0.1f;
+    view.farPlane = view.distance + view.radius + 100.f;
+    mat4_translate(frame.view, 0.f, 0.f, -view.distance);
+    mat4_perspective(frame.projection, view.fovy, aspect, view.zNear, view.farPlane);
+    frame.lightDir[0] = 0.5f; frame.lightDir[1] = -1.f; frame.lightDir[2] = 0.f;
+    return view;
 }
 
-Mesh loadOBJ(const std::string& filename) {
-    tinyobj::ObjReaderConfig config; config.triangulate = true;
-    tinyobj::ObjReader reader;
-    if (!reader.ParseFromFile(filename, config)) throw std::runtime_error("Failed to load OBJ");
-    const auto& attrib = reader.GetAttrib();
-    const auto& shapes = reader.GetShapes();
-
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
-    std::unordered_map<Vertex, uint32_t> uniqueVertices;
-
-    for (const auto& shape : shapes) {
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-            for (size_t v = 0; v < 3; v++) {
-                tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-                Vertex vertex{};
-                vertex.position = {
-                    attrib.vertices[3 * idx.vertex_index + 0],
-                    attrib.vertices[3 * idx.vertex_index + 1],
-                    attrib.vertices[3 * idx.vertex_index + 2]
-                };
-                vertex.normal = (!attrib.normals.empty() && idx.normal_index >= 0) ?
-                    vec3{attrib.normals[3 * idx.normal_index + 0], attrib.normals[3 * idx.normal_index + 1], attrib.normals[3 * idx.normal_index + 2]} :
-                    vec3{0.f, 0.f, 1.f};
-                vertex.texcoords = (!attrib.texcoords.empty() && idx.texcoord_index >= 0) ?
-                    vec2{attrib.texcoords[2 * idx.texcoord_index + 0], attrib.texcoords[2 * idx.texcoord_index + 1]} :
-                    vec2{0.f, 0.f};
-
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = (uint32_t)vertices.size();
-                    vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
-            }
-            index_offset += 3;
+// Renders the --instances or --draws scene with the CPU rasterizer, writing each frame to
+// --output and timing only the rendering.
+int runSoftwareRenderer(const Options& options, JobPool* jobs) {
+    std::vector<std::string> paths = options.meshes;
+    if (options.draws == 0 || paths.empty()) paths = { "cube.obj" };
+    std::vector<Mesh> meshes;
+    std::vector<float> radii;
+    for (const std::string& path : paths) {
+        meshes.push_back(loadOBJ(path));
+        radii.push_back(computeMeshBounds(meshes.back()).radius);
+    }
+    SoftTexture texture = loadSoftTexture("textures/texture.png");
+
+    const float spacing = 4.f;
+    uint32_t objectCount = options.draws > 0 ? options.draws : options.instances;
+    std::vector<float> transforms((size_t)objectCount * 16);
+    layoutInstanceGrid(transforms.data(), objectCount, spacing);
+    CullSpheres spheres;
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        const float* t = &transforms[(size_t)i * 16];
+        addCullSphere(spheres, t[12], t[13], t[14], radii[i % radii.size()]);
+    }
+    std::vector<uint32_t> visible(objectCount);
+
+    SoftRenderer renderer = createSoftRenderer(options.width, options.height);
+    const float clearColor[3] = { 0.1f, 0.1f, 0.1f };
+    uint32_t frames = options.benchFrames ? options.benchFrames : 1;
+    uint64_t trianglesSubmitted = 0, trianglesRasterized = 0, pixelsShaded = 0;
+    double seconds = 0.0;
+    for (uint32_t frameIndex = 0; frameIndex < frames; ++frameIndex) {
+        double start = nowSeconds();
+        FrameUniforms frame = {};
+        setupSceneView(frame, objectCount, spacing, (float)options.width / options.height);
+        float rotation[16];
+        mat4_rotate_y(rotation, frameIndex / 60.f * 0.5f);
+
+        uint32_t visibleCount = objectCount;
+        if (options.cull) {
+            float viewProjection[16];
+            mat4_mul(viewProjection, frame.projection, frame.view);
+            Frustum frustum;
+            extractFrustumPlanes(frustum, viewProjection);
+            visibleCount = cullSpheres(frustum, spheres, visible.data(), jobs);
+        } else {
+            for (uint32_t i = 0; i < objectCount; ++i) visible[i] = i;
         }
+
+        softBeginFrame(renderer, frame, clearColor);
+        for (uint32_t i = 0; i < visibleCount; ++i) {
+            uint32_t o = visible[i];
+            ObjectUniforms object;
+            mat4_mul(object.model, &transforms[(size_t)o * 16], rotation);
+            mat4_normal_matrix(object.normalMatrix, object.model);
+            softDrawMesh(renderer, meshes[o % meshes.size()], texture, object);
+        }
+        softEndFrame(renderer, jobs);
+        seconds += nowSeconds() - start;
+        trianglesSubmitted += renderer.stats.trianglesSubmitted;
+        trianglesRasterized += renderer.stats.trianglesRasterized;
+        pixelsShaded += renderer.stats.pixelsShaded;
+
+        std::string path = framePath(options.outputPattern, frameIndex);
+        if (!writeImage(path.c_str(), renderer.width, renderer.height, renderer.color.data()))
+            std::cerr << "Failed to write " << path << std::endl;
     }
+    for (Mesh& m : meshes) freeMesh(m);
+
+    printf("Software renderer: %u %dx%d frames on %u threads, %.3f ms per frame\n", frames, options.width, options.height,
+           jobPoolThreadCount(jobs), seconds * 1000.0 / frames);
+    printf("  %.2f M triangles/s submitted, %.2f M triangles/s rasterized, %.2f M pixels/s shaded\n",
+           trianglesSubmitted / seconds / 1e6, trianglesRasterized / seconds / 1e6, pixelsShaded / seconds / 1e6);
+    printf("Wrote %u frames to %s\n", frames, options.outputPattern.c_str());
+    return 0;
+}
 
-    Mesh mesh;
-    mesh.vertexCount = (uint32_t)vertices.size();
-    mesh.indexCount = (uint32_t)indices.size();
-    mesh.vertices = new Vertex[mesh.vertexCount];
-    mesh.indices = new uint32_t[mesh.indexCount];
-    std::copy(vertices.begin(), vertices.end(), mesh.vertices);
-    std::copy(indices.begin(), indices.end(), mesh.indices);
-    return mesh;
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string framePath(const std::string& pattern, uint32_t frame) {
+    size_t first = pattern.find('#');
+    if (first == std::string::npos) return pattern;
+    size_t width = pattern.find_first_not_of('#', first);
+    width = (width == std::string::npos ? pattern.size() : width) - first;
+    std::string number = std::to_string(frame);
+    if (number.size() < width) number.insert(0, width - number.size(), '0');
+    return pattern.substr(0, first) + number + pattern.substr(first + width);
+}
+
+void framebuffer_size_callback(GLFWwindow*, int w, int h) { glViewport(0, 0, w, h); }
+void processInput(GLFWwindow* window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
 }
 
 GLuint loadTexture(const char* path) {
@@ -252,7 +1483,7 @@ GLuint loadTexture(const char* path) {
 
     GLuint tex;
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    cachedBindTexture(0, GL_TEXTURE_2D, tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
@@ -263,3 +1494,50 @@ GLuint loadTexture(const char* path) {
     stbi_image_free(data);
     return tex;
 }
+
+SoftTexture loadSoftTexture(const char* path) {
+    int w, h, channels;
+    stbi_set_flip_vertically_on_load(1);
+    unsigned char* data = stbi_load(path, &w, &h, &channels, 3);
+    if (!data) throw std::runtime_error("Failed to load texture image");
+    SoftTexture texture = { w, h, std::vector<uint8_t>(data, data + (size_t)w * h * 3) };
+    stbi_image_free(data);
+    return texture;
+}
+
+// Writes a side x side height field in the xy plane whose waves travel with time.
+void writeWaveGrid(Vertex* out, uint32_t side, float time) {
+    const float extent = 2.5f, frequency = 6.f, amplitude = 0.15f;
+    std::vector<float> sinX(side), cosX(side), sinY(side), cosY(side);
+    for (uint32_t i = 0; i < side; ++i) {
+        float t = (float)i / (side - 1);
+        sinX[i] = sinf(t * frequency * 2.f + time); cosX[i] = cosf(t * frequency * 2.f + time);
+        sinY[i] = sinf(t * frequency + time * 0.7f); cosY[i] = cosf(t * frequency + time * 0.7f);
+    }
+    float scale = 2.f * extent / (side - 1);
+    for (uint32_t y = 0; y < side; ++y) {
+        for (uint32_t x = 0; x < side; ++x) {
+            Vertex& v = out[(size_t)y * side + x];
+            v.position = { x * scale - extent, y * scale - extent, amplitude * sinX[x] * cosY[y] };
+            // Gradient of the height in grid units, converted to world units for the normal.
+            float dx = amplitude * cosX[x] * cosY[y] * frequency * 2.f / (2.f * extent);
+            float dy = -amplitude * sinX[x] * sinY[y] * frequency / (2.f * extent);
+            float length = sqrtf(dx * dx + dy * dy + 1.f);
+            v.normal = { -dx / length, -dy / length, 1.f / length };
+            v.texcoords = { x * 4.f / (side - 1), y * 4.f / (side - 1) };
+        }
+    }
+}
+
+GLuint createSolidTexture(unsigned char r, unsigned char g, unsigned char b) {
+    unsigned char texel[3] = { r, g, b };
+    GLuint tex;
+    glGenTextures(1, &tex);
+    cachedBindTexture(0, GL_TEXTURE_2D, tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return tex;
+}
@@ -0,0 +1,228 @@
+#include "matrix.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_AVX 1
+#include <immintrin.h>
+#endif
+
+bool mat4_inverse_scalar(float* out, const float* m) {
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.f) return false;
+    for (int i = 0; i < 16; ++i) out[i] = inv[i] / det;
+    return true;
+}
+
+// Rows of the inverse of the upper 3x3 are the cross products of its columns over the determinant.
+static bool inverse3x3Rows(float rows[3][3], const float* m) {
+    const float* c0 = m; const float* c1 = m + 4; const float* c2 = m + 8;
+    float n[3][3] = {
+        { c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2], c1[0] * c2[1] - c1[1] * c2[0] },
+        { c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0] },
+        { c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2], c0[0] * c1[1] - c0[1] * c1[0] },
+    };
+    float det = c0[0] * n[0][0] + c0[1] * n[0][1] + c0[2] * n[0][2];
+    if (det == 0.f) return false;
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) rows[r][c] = n[r][c] / det;
+    return true;
+}
+
+void mat4_affine_inverse_scalar(float* out, const float* m) {
+    float rows[3][3];
+    if (!inverse3x3Rows(rows, m)) { mat4_identity(out); return; }
+    for (int c = 0; c < 3; ++c) {
+        for (int r = 0; r < 3; ++r) out[c * 4 + r] = rows[r][c];
+        out[c * 4 + 3] = 0.f;
+    }
+    for (int r = 0; r < 3; ++r) out[12 + r] = -(rows[r][0] * m[12] + rows[r][1] * m[13] + rows[r][2] * m[14]);
+    out[15] = 1.f;
+}
+
+void mat4_normal_matrix_scalar(float* out, const float* m) {
+    // The inverse transpose has the inverse's rows as its columns.
+    float rows[3][3];
+    if (!inverse3x3Rows(rows, m)) { for (int i = 0; i < 12; ++i) out[i] = (i % 5 == 0) ? 1.f : 0.f; return; }
+    for (int c = 0; c < 3; ++c) {
+        for (int r = 0; r < 3; ++r) out[c * 4 + r] = rows[c][r];
+        out[c * 4 + 3] = 0.f;
+    }
+}
+
+#ifdef MATRIX_SSE
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+
+static inline __m128 cross3(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 1, 2, 0, 3), SWIZZLE(b, 2, 0, 1, 3)),
+                      _mm_mul_ps(SWIZZLE(a, 2, 0, 1, 3), SWIZZLE(b, 1, 2, 0, 3)));
+}
+
+static inline __m128 sumAll(__m128 v) {
+    v = _mm_add_ps(v, SWIZZLE(v, 1, 0, 3, 2));
+    return _mm_add_ps(v, SWIZZLE(v, 2, 3, 0, 1));
+}
+
+// Cross products of the upper 3x3 columns scaled by 1/det, i.e. the rows of its inverse
+// (w lanes are zero). Returns false when the 3x3 is singular.
+static inline bool inverse3x3RowsSSE(__m128 rows[3], const float* m) {
+    const __m128 xyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    __m128 c0 = _mm_and_ps(_mm_loadu_ps(m), xyz);
+    __m128 c1 = _mm_and_ps(_mm_loadu_ps(m + 4), xyz);
+    __m128 c2 = _mm_and_ps(_mm_loadu_ps(m + 8), xyz);
+    __m128 n0 = cross3(c1, c2), n1 = cross3(c2, c0), n2 = cross3(c0, c1);
+    __m128 det = sumAll(_mm_mul_ps(c0, n0));
+    if (_mm_cvtss_f32(det) == 0.f) return false;
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+    rows[0] = _mm_mul_ps(n0, invDet);
+    rows[1] = _mm_mul_ps(n1, invDet);
+    rows[2] = _mm_mul_ps(n2, invDet);
+    return true;
+}
+
+// 2x2 blocks stored row-major in one register: (m00, m01, m10, m11).
+static inline __m128 mat2Mul(__m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+// adj(a) * b
+static inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+// a * adj(b)
+static inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
+
+bool mat4_inverse(float* out, const float* m) {
+#ifdef MATRIX_SSE
+    // Block inversion of [A B; C D] with 2x2 blocks. The columns are treated as rows: the
+    // inverse of the transpose is the transpose of the inverse, so the result needs no fixup.
+    __m128 r0 = _mm_loadu_ps(m), r1 = _mm_loadu_ps(m + 4), r2 = _mm_loadu_ps(m + 8), r3 = _mm_loadu_ps(m + 12);
+    __m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 dets = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+        _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+    __m128 detA = SWIZZLE(dets, 0, 0, 0, 0), detB = SWIZZLE(dets, 1, 1, 1, 1);
+    __m128 detC = SWIZZLE(dets, 2, 2, 2, 2), detD = SWIZZLE(dets, 3, 3, 3, 3);
+
+    __m128 adjDC = mat2AdjMul(D, C);
+    __m128 adjAB = mat2AdjMul(A, B);
+    __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, adjDC));
+    __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, adjAB));
+    __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, adjAB));
+    __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, adjDC));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 det = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+    det = _mm_sub_ps(det, sumAll(_mm_mul_ps(adjAB, SWIZZLE(adjDC, 0, 2, 1, 3))));
+    if (_mm_cvtss_f32(det) == 0.f) return false;
+    __m128 scale = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+    X = _mm_mul_ps(X, scale); Y = _mm_mul_ps(Y, scale);
+    Z = _mm_mul_ps(Z, scale); W = _mm_mul_ps(W, scale);
+
+    // Taking the adjugate of each block and storing it are one shuffle.
+    _mm_storeu_ps(out, _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(out + 12, _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2)));
+    return true;
+#else
+    return mat4_inverse_scalar(out, m);
+#endif
+}
+
+void mat4_affine_inverse(float* out, const float* m) {
+#ifdef MATRIX_SSE
+    __m128 rows[3];
+    if (!inverse3x3RowsSSE(rows, m)) { mat4_identity(out); return; }
+    __m128 c0 = rows[0], c1 = rows[1], c2 = rows[2], c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(m[12])), _mm_mul_ps(c1, _mm_set1_ps(m[13]))),
+                          _mm_mul_ps(c2, _mm_set1_ps(m[14])));
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, _mm_sub_ps(_mm_setr_ps(0.f, 0.f, 0.f, 1.f), t));
+#else
+    mat4_affine_inverse_scalar(out, m);
+#endif
+}
+
+void mat4_normal_matrix(float* out, const float* m) {
+#ifdef MATRIX_SSE
+    __m128 rows[3];
+    if (!inverse3x3RowsSSE(rows, m)) { for (int i = 0; i < 12; ++i) out[i] = (i % 5 == 0) ? 1.f : 0.f; return; }
+    _mm_storeu_ps(out, rows[0]);
+    _mm_storeu_ps(out + 4, rows[1]);
+    _mm_storeu_ps(out + 8, rows[2]);
+#else
+    mat4_normal_matrix_scalar(out, m);
+#endif
+}
+
+bool matrixHasAVX() {
+#ifdef MATRIX_AVX
+    static const bool supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#ifdef MATRIX_AVX
+// Output columns 0/1 and 2/3 each fill one 256-bit register: a's column k is broadcast to
+// both halves and multiplied by b's k-th row entries for the two columns.
+__attribute__((target("avx,fma")))
+static void mulBatchAVX(float* out, const float* a, const float* b, uint32_t count) {
+    __m256 b01[4], b23[4];
+    for (int k = 0; k < 4; ++k) {
+        b01[k] = _mm256_setr_ps(b[k], b[k], b[k], b[k], b[4 + k], b[4 + k], b[4 + k], b[4 + k]);
+        b23[k] = _mm256_setr_ps(b[8 + k], b[8 + k], b[8 + k], b[8 + k], b[12 + k], b[12 + k], b[12 + k], b[12 + k]);
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* ai = a + (size_t)i * 16;
+        __m256 a0 = _mm256_broadcast_ps((const __m128*)ai), a1 = _mm256_broadcast_ps((const __m128*)(ai + 4));
+        __m256 a2 = _mm256_broadcast_ps((const __m128*)(ai + 8)), a3 = _mm256_broadcast_ps((const __m128*)(ai + 12));
+        __m256 lo = _mm256_mul_ps(a0, b01[0]), hi = _mm256_mul_ps(a0, b23[0]);
+        lo = _mm256_fmadd_ps(a1, b01[1], lo); hi = _mm256_fmadd_ps(a1, b23[1], hi);
+        lo = _mm256_fmadd_ps(a2, b01[2], lo); hi = _mm256_fmadd_ps(a2, b23[2], hi);
+        lo = _mm256_fmadd_ps(a3, b01[3], lo); hi = _mm256_fmadd_ps(a3, b23[3], hi);
+        _mm256_storeu_ps(out + (size_t)i * 16, lo);
+        _mm256_storeu_ps(out + (size_t)i * 16 + 8, hi);
+    }
+}
+#endif
+
+void mat4_mul_batch(float* out, const float* a, const float* b, uint32_t count) {
+#ifdef MATRIX_AVX
+    if (matrixHasAVX()) { mulBatchAVX(out, a, b, count); return; }
+#endif
+    float rhs[16];
+    memcpy(rhs, b, sizeof(rhs));  // out may alias b when count == 1
+    for (uint32_t i = 0; i < count; ++i) mat4_mul(out + (size_t)i * 16, a + (size_t)i * 16, rhs);
+}
+
+void mat4_normal_batch(float* out, const float* m, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) mat4_normal_matrix(out + (size_t)i * 12, m + (size_t)i * 16);
+}
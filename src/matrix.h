@@ -0,0 +1,73 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MATRIX_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Column-major 4x4 matrices stored as float[16], matching what glUniformMatrix4fv and std140 expect.
+// Normal matrices (inverse transpose of the upper 3x3) are float[12]: three columns padded
+// to vec4, which is the std140 layout of a mat3.
+
+struct vec2 { float x, y; };
+struct vec3 { float x, y, z; };
+
+inline void mat4_identity(float* m) {
+    for (int i = 0; i < 16; ++i) m[i] = (i % 5 == 0) ? 1.f : 0.f;
+}
+inline void mat4_rotate_y(float* m, float angle) {
+    mat4_identity(m); float c = cosf(angle), s = sinf(angle);
+    m[0] = c; m[2] = s; m[8] = -s; m[10] = c;
+}
+inline void mat4_translate(float* m, float x, float y, float z) {
+    mat4_identity(m); m[12] = x; m[13] = y; m[14] = z;
+}
+inline void mat4_perspective(float* m, float fovy, float aspect, float znear, float zfar) {
+    mat4_identity(m);
+    float f = 1.f / tanf(fovy * 0.5f);
+    m[0] = f / aspect; m[5] = f;
+    m[10] = (zfar + znear) / (znear - zfar);
+    m[11] = -1.f; m[14] = (2.f * zfar * znear) / (znear - zfar); m[15] = 0.f;
+}
+// out = a * b; out may not alias a or b.
+inline void mat4_mul_scalar(float* out, const float* a, const float* b) {
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+}
+// out = a * b; out may alias a or b.
+inline void mat4_mul(float* out, const float* a, const float* b) {
+#ifdef MATRIX_SSE
+    __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    __m128 columns[4];
+    for (int c = 0; c < 4; ++c) {
+        const float* bc = b + c * 4;
+        columns[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bc[0])), _mm_mul_ps(a1, _mm_set1_ps(bc[1]))),
+                                _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bc[2])), _mm_mul_ps(a3, _mm_set1_ps(bc[3]))));
+    }
+    for (int c = 0; c < 4; ++c) _mm_storeu_ps(out + c * 4, columns[c]);
+#else
+    float result[16];
+    mat4_mul_scalar(result, a, b);
+    for (int i = 0; i < 16; ++i) out[i] = result[i];
+#endif
+}
+
+// Scalar references, kept for platforms without SSE and for the benchmark.
+bool mat4_inverse_scalar(float* out, const float* m);
+void mat4_affine_inverse_scalar(float* out, const float* m);
+void mat4_normal_matrix_scalar(float* out, const float* m);
+
+// General inverse; returns false and leaves out untouched when m is singular.
+bool mat4_inverse(float* out, const float* m);
+// Inverse of a matrix whose last row is (0, 0, 0, 1).
+void mat4_affine_inverse(float* out, const float* m);
+void mat4_normal_matrix(float* out, const float* m);
+
+// out[i] = a[i] * b for count matrices, eight floats at a time with AVX when the CPU has it.
+void mat4_mul_batch(float* out, const float* a, const float* b, uint32_t count);
+// out[i] = normal matrix of m[i]; out holds 12 floats per matrix.
+void mat4_normal_batch(float* out, const float* m, uint32_t count);
+bool matrixHasAVX();
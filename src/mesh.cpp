@@ -0,0 +1,100 @@
+#include "mesh.h"
+
+#include <tiny_obj_loader.h>
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+void freeMesh(Mesh& mesh) {
+    delete[] mesh.vertices;
+    delete[] mesh.indices;
+    mesh.vertices = nullptr; mesh.indices = nullptr;
+    mesh.vertexCount = mesh.indexCount = 0;
+}
+
+Mesh loadOBJ(const std::string& filename) {
+    tinyobj::ObjReaderConfig config; config.triangulate = true;
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(filename, config)) throw std::runtime_error("Failed to load OBJ");
+    const auto& attrib = reader.GetAttrib();
+    const auto& shapes = reader.GetShapes();
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::unordered_map<Vertex, uint32_t> uniqueVertices;
+
+    for (const auto& shape : shapes) {
+        size_t index_offset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
+            for (size_t v = 0; v < 3; v++) {
+                tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
+                Vertex vertex{};
+                vertex.position = {
+                    attrib.vertices[3 * idx.vertex_index + 0],
+                    attrib.vertices[3 * idx.vertex_index + 1],
+                    attrib.vertices[3 * idx.vertex_index + 2]
+                };
+                vertex.normal = (!attrib.normals.empty() && idx.normal_index >= 0) ?
+                    vec3{attrib.normals[3 * idx.normal_index + 0], attrib.normals[3 * idx.normal_index + 1], attrib.normals[3 * idx.normal_index + 2]} :
+                    vec3{0.f, 0.f, 1.f};
+                vertex.texcoords = (!attrib.texcoords.empty() && idx.texcoord_index >= 0) ?
+                    vec2{attrib.texcoords[2 * idx.texcoord_index + 0], attrib.texcoords[2 * idx.texcoord_index + 1]} :
+                    vec2{0.f, 0.f};
+
+                if (uniqueVertices.count(vertex) == 0) {
+                    uniqueVertices[vertex] = (uint32_t)vertices.size();
+                    vertices.push_back(vertex);
+                }
+                indices.push_back(uniqueVertices[vertex]);
+            }
+            index_offset += 3;
+        }
+    }
+
+    Mesh mesh;
+    mesh.vertexCount = (uint32_t)vertices.size();
+    mesh.indexCount = (uint32_t)indices.size();
+    mesh.vertices = new Vertex[mesh.vertexCount];
+    mesh.indices = new uint32_t[mesh.indexCount];
+    std::copy(vertices.begin(), vertices.end(), mesh.vertices);
+    std::copy(indices.begin(), indices.end(), mesh.indices);
+    return mesh;
+}
+
+MeshBounds computeMeshBounds(const Mesh& mesh) {
+    MeshBounds bounds = { { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f }, 0.f };
+    for (uint32_t i = 0; i < mesh.vertexCount; ++i) {
+        const vec3& p = mesh.vertices[i].position;
+        const float v[3] = { p.x, p.y, p.z };
+        for (int a = 0; a < 3; ++a) {
+            bounds.min[a] = (i == 0 || v[a] < bounds.min[a]) ? v[a] : bounds.min[a];
+            bounds.max[a] = (i == 0 || v[a] > bounds.max[a]) ? v[a] : bounds.max[a];
+        }
+        bounds.radius = std::max(bounds.radius, sqrtf(p.x * p.x + p.y * p.y + p.z * p.z));
+    }
+    return bounds;
+}
+
+std::vector<vec3> meshPositions(const Mesh& mesh) {
+    std::vector<vec3> positions(mesh.vertexCount);
+    for (uint32_t i = 0; i < mesh.vertexCount; ++i) positions[i] = mesh.vertices[i].position;
+    return positions;
+}
+
+void setPositionLayout() {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+}
+
+void setVertexLayout() {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texcoords));
+    glEnableVertexAttribArray(2);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "matrix.h"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Vertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texcoords;
+    bool operator==(const Vertex& other) const {
+        return memcmp(this, &other, sizeof(Vertex)) == 0;
+    }
+};
+
+namespace std {
+    template<> struct hash<Vertex> {
+        std::size_t operator()(const Vertex& v) const {
+            size_t h1 = hash<float>()(v.position.x) ^ hash<float>()(v.position.y) ^ hash<float>()(v.position.z);
+            size_t h2 = hash<float>()(v.normal.x) ^ hash<float>()(v.normal.y) ^ hash<float>()(v.normal.z);
+            size_t h3 = hash<float>()(v.texcoords.x) ^ hash<float>()(v.texcoords.y);
+            return h1 ^ (h2 << 1) ^ (h3 << 2);
+        }
+    };
+}
+
+struct Mesh {
+    Vertex* vertices;
+    uint32_t* indices;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+
+// Axis-aligned box plus the radius of the smallest origin-centred sphere around the mesh,
+// which stays valid however the mesh is rotated about its origin.
+struct MeshBounds {
+    float min[3], max[3];
+    float radius;
+};
+
+Mesh loadOBJ(const std::string&);
+void freeMesh(Mesh&);
+MeshBounds computeMeshBounds(const Mesh&);
+// Points attributes 0-2 of the bound VAO at the Vertex layout of the bound GL_ARRAY_BUFFER.
+void setVertexLayout();
+// Position-only stream for depth-only passes: attribute 0 reads tightly packed vec3s.
+std::vector<vec3> meshPositions(const Mesh& mesh);
+void setPositionLayout();
@@ -0,0 +1,198 @@
+#include "mesh_pool.h"
+
+#include "gl_state.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+MeshPool createMeshPool(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    MeshPool pool = {};
+    pool.vertexCapacity = vertexCapacity;
+    pool.indexCapacity = indexCapacity;
+    pool.vertexAllocator = createOffsetAllocator(vertexCapacity);
+    pool.indexAllocator = createOffsetAllocator(indexCapacity);
+    glGenBuffers(1, &pool.vbo); glGenBuffers(1, &pool.ebo); glGenBuffers(1, &pool.positionVbo);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.positionVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * sizeof(vec3), nullptr, GL_STATIC_DRAW);
+    pool.vao = createMeshPoolVao(pool, false);
+    pool.positionVao = createMeshPoolVao(pool, true);
+    return pool;
+}
+
+GLuint createMeshPoolVao(const MeshPool& pool, bool positionsOnly) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    cachedBindVertexArray(vao);
+    cachedBindBuffer(GL_ARRAY_BUFFER, positionsOnly ? pool.positionVbo : pool.vbo);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.ebo);
+    if (positionsOnly) setPositionLayout(); else setVertexLayout();
+    cachedBindVertexArray(0);
+    return vao;
+}
+
+void freeMeshPool(MeshPool& pool) {
+    cachedDeleteBuffers(1, &pool.vbo); cachedDeleteBuffers(1, &pool.ebo); cachedDeleteBuffers(1, &pool.positionVbo);
+    cachedDeleteVertexArrays(1, &pool.vao); cachedDeleteVertexArrays(1, &pool.positionVao);
+    pool = {};
+}
+
+// Reserves space for a mesh and gives it a handle; the caller fills in the data.
+static MeshHandle allocatePoolMesh(MeshPool& pool, uint32_t vertexCount, uint32_t indexCount) {
+    OffsetAllocation vertices = allocateOffset(pool.vertexAllocator, vertexCount);
+    OffsetAllocation indices = allocateOffset(pool.indexAllocator, indexCount);
+    if (vertices.node == OFFSET_ALLOCATOR_NO_SPACE || indices.node == OFFSET_ALLOCATOR_NO_SPACE) {
+        freeOffset(pool.vertexAllocator, vertices);
+        freeOffset(pool.indexAllocator, indices);
+        throw std::runtime_error("Mesh pool is full");
+    }
+    pool.vertexCount += vertexCount;
+    pool.indexCount += indexCount;
+
+    MeshHandle handle;
+    if (!pool.freeHandles.empty()) {
+        handle = pool.freeHandles.back();
+        pool.freeHandles.pop_back();
+    } else {
+        handle = (MeshHandle)pool.meshes.size();
+        pool.meshes.emplace_back();
+    }
+    pool.meshes[handle] = { vertices, indices, vertexCount, { indices.offset, indexCount, (int32_t)vertices.offset }, true };
+    return handle;
+}
+
+MeshHandle addMeshToPool(MeshPool& pool, const Mesh& mesh) {
+    MeshHandle handle = allocatePoolMesh(pool, mesh.vertexCount, mesh.indexCount);
+    const MeshRange& range = pool.meshes[handle].range;
+
+    // GL_COPY_WRITE_BUFFER keeps the upload from touching whichever VAO is bound.
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.baseVertex * sizeof(Vertex), (GLsizeiptr)mesh.vertexCount * sizeof(Vertex), mesh.vertices);
+    std::vector<vec3> positions = meshPositions(mesh);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.positionVbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.baseVertex * sizeof(vec3), (GLsizeiptr)positions.size() * sizeof(vec3), positions.data());
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.firstIndex * sizeof(uint32_t), (GLsizeiptr)mesh.indexCount * sizeof(uint32_t), mesh.indices);
+    return handle;
+}
+
+MeshHandle addMeshToPoolFromBuffer(MeshPool& pool, GLuint buffer, uint32_t vertexCount, uint32_t indexCount) {
+    MeshHandle handle = allocatePoolMesh(pool, vertexCount, indexCount);
+    const MeshRange& range = pool.meshes[handle].range;
+    GLintptr positions = (GLintptr)vertexCount * sizeof(Vertex);
+    GLintptr indices = positions + (GLintptr)vertexCount * sizeof(vec3);
+    cachedBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)range.baseVertex * sizeof(Vertex), positions);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.positionVbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, positions, (GLintptr)range.baseVertex * sizeof(vec3), indices - positions);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, indices, (GLintptr)range.firstIndex * sizeof(uint32_t), (GLsizeiptr)indexCount * sizeof(uint32_t));
+    cachedBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return handle;
+}
+
+void removeMeshFromPool(MeshPool& pool, MeshHandle handle) {
+    PoolMesh& mesh = pool.meshes[handle];
+    if (!mesh.live) return;
+    freeOffset(pool.vertexAllocator, mesh.vertices);
+    freeOffset(pool.indexAllocator, mesh.indices);
+    pool.vertexCount -= mesh.vertexCount;
+    pool.indexCount -= mesh.range.indexCount;
+    mesh = {};
+    pool.freeHandles.push_back(handle);
+}
+
+const MeshRange& meshRange(const MeshPool& pool, MeshHandle handle) {
+    return pool.meshes[handle].range;
+}
+
+struct BufferMove {
+    uint32_t from, to, count;
+};
+
+// Copies the live ranges into a scratch buffer at their packed offsets, then the packed
+// block back to the start of the buffer. Going through scratch keeps sources and
+// destinations from overlapping and leaves the buffer name, and so every VAO, untouched.
+static void packBuffer(GLuint buffer, GLsizeiptr elementSize, const std::vector<BufferMove>& moves, uint32_t total) {
+    if (total == 0) return;
+    GLuint scratch;
+    glGenBuffers(1, &scratch);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+    glBufferData(GL_COPY_WRITE_BUFFER, total * elementSize, nullptr, GL_STREAM_COPY);
+    cachedBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    for (const BufferMove& move : moves)
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.from * elementSize, move.to * elementSize, move.count * elementSize);
+    cachedBindBuffer(GL_COPY_READ_BUFFER, scratch);
+    cachedBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, total * elementSize);
+    cachedBindBuffer(GL_COPY_READ_BUFFER, 0);
+    cachedDeleteBuffers(1, &scratch);
+}
+
+// Appends a move, merging it with the previous one when both ends continue it.
+static void addMove(std::vector<BufferMove>& moves, uint32_t from, uint32_t to, uint32_t count) {
+    if (!moves.empty()) {
+        BufferMove& last = moves.back();
+        if (last.from + last.count == from && last.to + last.count == to) {
+            last.count += count;
+            return;
+        }
+    }
+    moves.push_back({ from, to, count });
+}
+
+void compactMeshPool(MeshPool& pool) {
+    // Keeping the current order of offsets means meshes that were already adjacent
+    // stay adjacent, so runs of them move with a single copy.
+    std::vector<MeshHandle> live;
+    for (MeshHandle h = 0; h < pool.meshes.size(); ++h)
+        if (pool.meshes[h].live) live.push_back(h);
+
+    std::vector<BufferMove> vertexMoves, indexMoves;
+    std::sort(live.begin(), live.end(), [&](MeshHandle a, MeshHandle b) { return pool.meshes[a].vertices.offset < pool.meshes[b].vertices.offset; });
+    uint32_t vertexTotal = 0;
+    for (MeshHandle h : live) {
+        const PoolMesh& mesh = pool.meshes[h];
+        addMove(vertexMoves, mesh.vertices.offset, vertexTotal, mesh.vertexCount);
+        vertexTotal += mesh.vertexCount;
+    }
+    std::vector<MeshHandle> byIndex = live;
+    std::sort(byIndex.begin(), byIndex.end(), [&](MeshHandle a, MeshHandle b) { return pool.meshes[a].indices.offset < pool.meshes[b].indices.offset; });
+    uint32_t indexTotal = 0;
+    for (MeshHandle h : byIndex) {
+        const PoolMesh& mesh = pool.meshes[h];
+        addMove(indexMoves, mesh.indices.offset, indexTotal, mesh.range.indexCount);
+        indexTotal += mesh.range.indexCount;
+    }
+
+    packBuffer(pool.vbo, sizeof(Vertex), vertexMoves, vertexTotal);
+    packBuffer(pool.positionVbo, sizeof(vec3), vertexMoves, vertexTotal);
+    packBuffer(pool.ebo, sizeof(uint32_t), indexMoves, indexTotal);
+
+    // Indices are relative to baseVertex, so they need no rewriting. A fresh allocator
+    // hands out blocks front to back, which reproduces the packed layout.
+    resetOffsetAllocator(pool.vertexAllocator);
+    resetOffsetAllocator(pool.indexAllocator);
+    for (MeshHandle h : live) {
+        PoolMesh& mesh = pool.meshes[h];
+        mesh.vertices = allocateOffset(pool.vertexAllocator, mesh.vertexCount);
+        mesh.range.baseVertex = (int32_t)mesh.vertices.offset;
+    }
+    for (MeshHandle h : byIndex) {
+        PoolMesh& mesh = pool.meshes[h];
+        mesh.indices = allocateOffset(pool.indexAllocator, mesh.range.indexCount);
+        mesh.range.firstIndex = mesh.indices.offset;
+    }
+}
+
+MeshPoolStats meshPoolStats(const MeshPool& pool) {
+    MeshPoolStats stats = {};
+    stats.meshes = (uint32_t)(pool.meshes.size() - pool.freeHandles.size());
+    stats.vertices = offsetAllocatorReport(pool.vertexAllocator);
+    stats.indices = offsetAllocatorReport(pool.indexAllocator);
+    return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "mesh.h"
+#include "offset_allocator.h"
+
+#include <cstdint>
+#include <vector>
+
+// All meshes share one VAO, vertex buffer and index buffer; a mesh is identified by
+// where its indices and vertices start, which is what base-vertex and indirect draws need.
+// A second VAO reads the same indices with a position-only stream for depth-only passes.
+// Space in the buffers comes from offset allocators, so meshes can be removed and added
+// at any time; compactMeshPool packs the survivors when the free space gets fragmented.
+
+struct MeshRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+};
+
+typedef uint32_t MeshHandle;
+const MeshHandle NO_MESH = 0xFFFFFFFFu;
+
+struct PoolMesh {
+    OffsetAllocation vertices, indices;
+    uint32_t vertexCount;
+    MeshRange range;
+    bool live;
+};
+
+struct MeshPool {
+    GLuint vao, vbo, ebo;
+    GLuint positionVao, positionVbo;
+    uint32_t vertexCapacity, indexCapacity;
+    uint32_t vertexCount, indexCount;  // live totals
+    OffsetAllocator vertexAllocator, indexAllocator;
+    std::vector<PoolMesh> meshes;  // indexed by MeshHandle
+    std::vector<MeshHandle> freeHandles;
+};
+
+struct MeshPoolStats {
+    uint32_t meshes;
+    OffsetAllocatorReport vertices, indices;
+};
+
+MeshPool createMeshPool(uint32_t vertexCapacity, uint32_t indexCapacity);
+void freeMeshPool(MeshPool& pool);
+// Throws when either buffer has no free block large enough; compacting may make room.
+MeshHandle addMeshToPool(MeshPool& pool, const Mesh& mesh);
+// Copies a mesh already in a GL buffer into the pool on the GPU. The buffer holds the
+// vertices, then their positions as vec3s, then the indices, all tightly packed.
+MeshHandle addMeshToPoolFromBuffer(MeshPool& pool, GLuint buffer, uint32_t vertexCount, uint32_t indexCount);
+void removeMeshFromPool(MeshPool& pool, MeshHandle handle);
+const MeshRange& meshRange(const MeshPool& pool, MeshHandle handle);
+// Moves every live mesh to the front of the buffers with GPU copies, leaving one free
+// block at the end. Handles stay valid but ranges change, so fetch them again afterwards.
+void compactMeshPool(MeshPool& pool);
+MeshPoolStats meshPoolStats(const MeshPool& pool);
+// Another VAO over the pool buffers, for a different instance stream.
+GLuint createMeshPoolVao(const MeshPool& pool, bool positionsOnly);
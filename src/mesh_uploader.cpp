@@ -0,0 +1,125 @@
+#include "mesh_uploader.h"
+
+#include "gl_state.h"
+
+#include <chrono>
+#include <stdexcept>
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The GL state cache belongs to the render thread's context, so the upload thread binds
+// buffers directly.
+static void stageMesh(StagedMesh& staged) {
+    double start = nowMs();
+    const Mesh& mesh = staged.mesh;
+    GLsizeiptr vertexBytes = (GLsizeiptr)mesh.vertexCount * sizeof(Vertex);
+    GLsizeiptr positionBytes = (GLsizeiptr)mesh.vertexCount * sizeof(vec3);
+    GLsizeiptr indexBytes = (GLsizeiptr)mesh.indexCount * sizeof(uint32_t);
+    std::vector<vec3> positions = meshPositions(mesh);
+    glGenBuffers(1, &staged.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, staged.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes + positionBytes + indexBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, vertexBytes, mesh.vertices);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexBytes, positionBytes, positions.data());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertexBytes + positionBytes, indexBytes, mesh.indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    // The flush makes sure the fence reaches the GPU, or the render thread could poll it forever.
+    staged.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    staged.stageMs = nowMs() - start;
+}
+
+static void uploadThread(MeshUploader* uploader, std::function<void()> makeCurrent, std::function<void()> release) {
+    makeCurrent();
+    while (!uploader->quit) {
+        StagedMesh staged;
+        if (!tryPop(uploader->requests, staged)) {
+            std::unique_lock<std::mutex> lock(uploader->mutex);
+            uploader->wake.wait(lock, [&] { return uploader->quit || uploader->queued.load() > 0; });
+            if (uploader->quit) break;
+            continue;
+        }
+        uploader->queued.fetch_sub(1);
+        stageMesh(staged);
+        // The render thread drains this queue every frame, so it only fills up when the
+        // loaders run far ahead of it, or once it has stopped polling to shut down.
+        while (!tryPush(uploader->staged, staged)) {
+            if (uploader->quit) {
+                glDeleteSync(staged.fence);
+                glDeleteBuffers(1, &staged.buffer);
+                freeMesh(staged.mesh);
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+    release();
+}
+
+MeshUploader* createMeshUploader(std::function<void()> makeCurrent, std::function<void()> release, uint32_t capacity) {
+    MeshUploader* uploader = new MeshUploader();
+    initLockFreeQueue(uploader->requests, capacity);
+    initLockFreeQueue(uploader->staged, capacity);
+    uploader->queued = 0;
+    uploader->quit = false;
+    uploader->thread = std::thread(uploadThread, uploader, makeCurrent, release);
+    return uploader;
+}
+
+void stopMeshUploader(MeshUploader* uploader) {
+    {
+        std::lock_guard<std::mutex> lock(uploader->mutex);
+        uploader->quit = true;
+    }
+    uploader->wake.notify_one();
+}
+
+void freeMeshUploader(MeshUploader* uploader) {
+    stopMeshUploader(uploader);
+    uploader->thread.join();
+
+    StagedMesh staged;
+    while (tryPop(uploader->requests, staged)) freeMesh(staged.mesh);
+    while (tryPop(uploader->staged, staged)) uploader->pending.push_back(staged);
+    for (StagedMesh& mesh : uploader->pending) {
+        glDeleteSync(mesh.fence);
+        cachedDeleteBuffers(1, &mesh.buffer);
+        freeMesh(mesh.mesh);
+    }
+    delete uploader;
+}
+
+bool queueMeshUpload(MeshUploader* uploader, uint64_t id, const Mesh& mesh) {
+    StagedMesh request = { id, mesh, 0, nullptr, 0.0 };
+    if (!tryPush(uploader->requests, request)) return false;
+    uploader->queued.fetch_add(1);
+    // Taking the lock, even empty-handed, orders the count against the upload thread's
+    // check of it, so the wakeup cannot be lost between that check and its wait.
+    { std::lock_guard<std::mutex> lock(uploader->mutex); }
+    uploader->wake.notify_one();
+    return true;
+}
+
+void pollMeshUploads(MeshUploader* uploader, MeshPool& pool, std::vector<ReadyMesh>& ready) {
+    StagedMesh staged;
+    while (tryPop(uploader->staged, staged)) uploader->pending.push_back(staged);
+    size_t kept = 0;
+    for (StagedMesh& mesh : uploader->pending) {
+        if (glClientWaitSync(mesh.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            uploader->pending[kept++] = mesh;
+            continue;
+        }
+        glDeleteSync(mesh.fence);
+        MeshHandle handle = NO_MESH;
+        try {
+            handle = addMeshToPoolFromBuffer(pool, mesh.buffer, mesh.mesh.vertexCount, mesh.mesh.indexCount);
+        } catch (const std::runtime_error&) {
+        }
+        // GL keeps the buffer alive until the copy out of it has run.
+        cachedDeleteBuffers(1, &mesh.buffer);
+        ready.push_back({ mesh.id, mesh.mesh, handle, mesh.stageMs });
+    }
+    uploader->pending.resize(kept);
+}
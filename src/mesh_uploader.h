@@ -0,0 +1,54 @@
+#pragma once
+#include "lock_free_queue.h"
+#include "mesh_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Moves mesh uploads off the render thread. Loader threads hand finished meshes to an
+// upload thread that owns a GL context shared with the renderer; it writes each mesh
+// into a staging buffer and fences it. The render thread polls the fences without
+// waiting and copies signalled meshes into the mesh pool on the GPU.
+
+struct StagedMesh {
+    uint64_t id;
+    Mesh mesh;
+    GLuint buffer;  // laid out for addMeshToPoolFromBuffer
+    GLsync fence;
+    double stageMs;
+};
+
+struct ReadyMesh {
+    uint64_t id;
+    Mesh mesh;         // the CPU copy goes back to the caller
+    MeshHandle handle; // NO_MESH when the pool had no room
+    double stageMs;
+};
+
+struct MeshUploader {
+    std::thread thread;
+    LockFreeQueue<StagedMesh> requests;  // loaders to the upload thread
+    LockFreeQueue<StagedMesh> staged;    // upload thread to the render thread
+    std::vector<StagedMesh> pending;     // render thread only: staged, fence not yet signalled
+    std::atomic<uint32_t> queued;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> quit;  // loaders waiting for room check it too
+};
+
+// makeCurrent and release run on the upload thread to bind and unbind the shared context.
+MeshUploader* createMeshUploader(std::function<void()> makeCurrent, std::function<void()> release, uint32_t capacity = 256);
+// Any thread. Tells the upload thread, and loaders waiting for room, to give up. Join the
+// loaders after this and before freeMeshUploader.
+void stopMeshUploader(MeshUploader* uploader);
+// Render thread. Stops and joins the upload thread and frees every mesh still in flight.
+void freeMeshUploader(MeshUploader* uploader);
+// Any thread. Takes ownership of the mesh data; returns false when the queue is full.
+bool queueMeshUpload(MeshUploader* uploader, uint64_t id, const Mesh& mesh);
+// Render thread. Appends meshes whose staging has finished on the GPU, now in the pool.
+void pollMeshUploads(MeshUploader* uploader, MeshPool& pool, std::vector<ReadyMesh>& ready);
@@ -0,0 +1,211 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+OcclusionBuffer createOcclusionBuffer(int width, int height) {
+    OcclusionBuffer buffer = {};
+    buffer.tilesX = (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE;
+    buffer.tilesY = (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE;
+    buffer.width = buffer.tilesX * OCCLUSION_TILE_SIZE;
+    buffer.height = buffer.tilesY * OCCLUSION_TILE_SIZE;
+    buffer.tileBins.resize((size_t)buffer.tilesX * buffer.tilesY);
+    // Sizes round up, so texel x of level L covers pixels [x << L, (x + 1) << L) and the odd
+    // last row or column of a level still feeds the level above.
+    for (int w = buffer.width, h = buffer.height; ; w = (w + 1) / 2, h = (h + 1) / 2) {
+        buffer.levels.emplace_back((size_t)w * h, 1.f);
+        buffer.levelWidth.push_back(w);
+        buffer.levelHeight.push_back(h);
+        if (w == 1 && h == 1) break;
+    }
+    return buffer;
+}
+
+void beginOcclusionFrame(OcclusionBuffer& buffer, const float* viewProjection) {
+    memcpy(buffer.viewProjection, viewProjection, sizeof(buffer.viewProjection));
+    buffer.triangles.clear();
+    for (std::vector<uint32_t>& bin : buffer.tileBins) bin.clear();
+    std::fill(buffer.levels[0].begin(), buffer.levels[0].end(), 1.f);
+}
+
+static void transformPoint(const float* m, float x, float y, float z, float* clip) {
+    for (int r = 0; r < 4; ++r) clip[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+}
+
+void addOccluder(OcclusionBuffer& buffer, const Mesh& mesh, const float* model) {
+    float mvp[16];
+    mat4_mul(mvp, buffer.viewProjection, model);
+    std::vector<float> screen((size_t)mesh.vertexCount * 4);
+    for (uint32_t i = 0; i < mesh.vertexCount; ++i) {
+        const vec3& p = mesh.vertices[i].position;
+        float clip[4];
+        transformPoint(mvp, p.x, p.y, p.z, clip);
+        float* s = &screen[(size_t)i * 4];
+        s[3] = clip[3];
+        if (clip[3] <= 1e-5f) continue;
+        s[0] = (clip[0] / clip[3] * 0.5f + 0.5f) * buffer.width;
+        s[1] = (clip[1] / clip[3] * 0.5f + 0.5f) * buffer.height;
+        s[2] = clip[2] / clip[3] * 0.5f + 0.5f;
+    }
+
+    for (uint32_t t = 0; t + 2 < mesh.indexCount; t += 3) {
+        const float* v[3] = { &screen[(size_t)mesh.indices[t] * 4], &screen[(size_t)mesh.indices[t + 1] * 4],
+                              &screen[(size_t)mesh.indices[t + 2] * 4] };
+        // Triangles crossing the near plane are skipped, which only ever makes culling less aggressive.
+        if (v[0][3] <= 1e-5f || v[1][3] <= 1e-5f || v[2][3] <= 1e-5f) continue;
+        OccluderTriangle tri;
+        for (int k = 0; k < 3; ++k) { tri.x[k] = v[k][0]; tri.y[k] = v[k][1]; tri.z[k] = v[k][2]; }
+        float minX = std::min({ tri.x[0], tri.x[1], tri.x[2] }), maxX = std::max({ tri.x[0], tri.x[1], tri.x[2] });
+        float minY = std::min({ tri.y[0], tri.y[1], tri.y[2] }), maxY = std::max({ tri.y[0], tri.y[1], tri.y[2] });
+        if (maxX < 0.f || maxY < 0.f || minX >= buffer.width || minY >= buffer.height) continue;
+
+        uint32_t index = (uint32_t)buffer.triangles.size();
+        buffer.triangles.push_back(tri);
+        int tx0 = (int)std::max(0.f, minX) / OCCLUSION_TILE_SIZE, tx1 = (int)std::min(buffer.width - 1.f, maxX) / OCCLUSION_TILE_SIZE;
+        int ty0 = (int)std::max(0.f, minY) / OCCLUSION_TILE_SIZE, ty1 = (int)std::min(buffer.height - 1.f, maxY) / OCCLUSION_TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ++ty)
+            for (int tx = tx0; tx <= tx1; ++tx) buffer.tileBins[(size_t)ty * buffer.tilesX + tx].push_back(index);
+    }
+}
+
+// Edge functions E = A*x + B*y + C are non-negative inside a counter-clockwise triangle, and
+// depth is the plane z = zA*x + zB*y + zC through the three vertices.
+static void rasterizeTile(OcclusionBuffer& buffer, int tile) {
+    int tileX = tile % buffer.tilesX * OCCLUSION_TILE_SIZE, tileY = tile / buffer.tilesX * OCCLUSION_TILE_SIZE;
+    float* depth = buffer.levels[0].data();
+    for (uint32_t index : buffer.tileBins[tile]) {
+        OccluderTriangle tri = buffer.triangles[index];
+        float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+        if (fabsf(area) < 1e-8f) continue;
+        if (area < 0.f) {
+            std::swap(tri.x[1], tri.x[2]); std::swap(tri.y[1], tri.y[2]); std::swap(tri.z[1], tri.z[2]);
+            area = -area;
+        }
+        float A[3], B[3], C[3];
+        for (int e = 0; e < 3; ++e) {
+            int a = (e + 1) % 3, b = (e + 2) % 3;
+            A[e] = tri.y[a] - tri.y[b];
+            B[e] = tri.x[b] - tri.x[a];
+            C[e] = -A[e] * tri.x[a] - B[e] * tri.y[a];
+        }
+        float zA = (A[0] * tri.z[0] + A[1] * tri.z[1] + A[2] * tri.z[2]) / area;
+        float zB = (B[0] * tri.z[0] + B[1] * tri.z[1] + B[2] * tri.z[2]) / area;
+        float zC = (C[0] * tri.z[0] + C[1] * tri.z[1] + C[2] * tri.z[2]) / area;
+        // Push every edge out by ~1/1000 pixel so rounding cannot open cracks along shared
+        // edges; a single missed pixel would stay far through every max-depth pyramid level.
+        for (int e = 0; e < 3; ++e) C[e] += (fabsf(A[e]) + fabsf(B[e])) * 1e-3f;
+
+        // Clamp in float first: vertices close to the eye can project far outside the int range.
+        float tileX0 = (float)tileX, tileX1 = (float)(tileX + OCCLUSION_TILE_SIZE);
+        float tileY0 = (float)tileY, tileY1 = (float)(tileY + OCCLUSION_TILE_SIZE);
+        int x0 = (int)std::max(tileX0, std::min({ tri.x[0], tri.x[1], tri.x[2] })) & ~3;
+        int x1 = (int)ceilf(std::min(tileX1, std::max({ tri.x[0], tri.x[1], tri.x[2] })));
+        int y0 = (int)std::max(tileY0, std::min({ tri.y[0], tri.y[1], tri.y[2] }));
+        int y1 = (int)ceilf(std::min(tileY1, std::max({ tri.y[0], tri.y[1], tri.y[2] })));
+        for (int y = y0; y < y1; ++y) {
+            float py = y + 0.5f;
+            float* row = depth + (size_t)y * buffer.width;
+#ifdef OCCLUSION_SSE
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f), zero = _mm_setzero_ps();
+            for (int x = x0; x < x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int e = 0; e < 3; ++e) {
+                    __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[e]), px), _mm_set1_ps(B[e] * py + C[e]));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+                }
+                if (_mm_movemask_ps(inside) == 0) continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * py + zC));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearer = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = x0; x < x1; ++x) {
+                float px = x + 0.5f;
+                if (A[0] * px + B[0] * py + C[0] < 0.f || A[1] * px + B[1] * py + C[1] < 0.f || A[2] * px + B[2] * py + C[2] < 0.f) continue;
+                row[x] = std::min(row[x], zA * px + zB * py + zC);
+            }
+#endif
+        }
+    }
+}
+
+void rasterizeOccluders(OcclusionBuffer& buffer, JobPool* pool) {
+    parallelFor(pool, (uint32_t)buffer.tileBins.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; ++tile) rasterizeTile(buffer, (int)tile);
+    });
+}
+
+void buildDepthPyramid(OcclusionBuffer& buffer) {
+    for (size_t level = 1; level < buffer.levels.size(); ++level) {
+        const std::vector<float>& src = buffer.levels[level - 1];
+        std::vector<float>& dst = buffer.levels[level];
+        int sw = buffer.levelWidth[level - 1], sh = buffer.levelHeight[level - 1];
+        int dw = buffer.levelWidth[level], dh = buffer.levelHeight[level];
+        for (int y = 0; y < dh; ++y) {
+            for (int x = 0; x < dw; ++x) {
+                // At an odd edge the second texel is past the end; reading the first twice keeps the max.
+                int sx0 = x * 2, sx1 = std::min(x * 2 + 1, sw - 1);
+                int sy0 = y * 2, sy1 = std::min(y * 2 + 1, sh - 1);
+                dst[(size_t)y * dw + x] = std::max(std::max(src[(size_t)sy0 * sw + sx0], src[(size_t)sy0 * sw + sx1]),
+                                                   std::max(src[(size_t)sy1 * sw + sx0], src[(size_t)sy1 * sw + sx1]));
+            }
+        }
+    }
+}
+
+bool testOcclusionBox(const OcclusionBuffer& buffer, const float* minCorner, const float* maxCorner) {
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1.f;
+    for (int c = 0; c < 8; ++c) {
+        float clip[4];
+        transformPoint(buffer.viewProjection, (c & 1) ? maxCorner[0] : minCorner[0],
+                       (c & 2) ? maxCorner[1] : minCorner[1], (c & 4) ? maxCorner[2] : minCorner[2], clip);
+        if (clip[3] <= 1e-5f) return true;
+        float sx = (clip[0] / clip[3] * 0.5f + 0.5f) * buffer.width;
+        float sy = (clip[1] / clip[3] * 0.5f + 0.5f) * buffer.height;
+        minX = std::min(minX, sx); maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy); maxY = std::max(maxY, sy);
+        minZ = std::min(minZ, clip[2] / clip[3] * 0.5f + 0.5f);
+    }
+    if (maxX < 0.f || maxY < 0.f || minX >= buffer.width || minY >= buffer.height) return false;
+    if (minZ <= 0.f) return true;
+
+    int x0 = (int)std::max(0.f, minX), x1 = (int)std::min(buffer.width - 1.f, maxX);
+    int y0 = (int)std::max(0.f, minY), y1 = (int)std::min(buffer.height - 1.f, maxY);
+    // Pick the level where the rectangle covers at most two texels in each direction.
+    int level = 0;
+    while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1) ++level;
+    level = std::min(level, (int)buffer.levels.size() - 1);
+    const std::vector<float>& depth = buffer.levels[level];
+    int lw = buffer.levelWidth[level];
+    // Level sizes round up, so these texels lie inside the level and cover the rectangle.
+    for (int y = y0 >> level; y <= y1 >> level; ++y)
+        for (int x = x0 >> level; x <= x1 >> level; ++x)
+            if (minZ <= depth[(size_t)y * lw + x]) return true;
+    return false;
+}
+
+uint32_t cullOccludedSpheres(const OcclusionBuffer& buffer, const CullSpheres& spheres, uint32_t* visible,
+                             uint32_t count, JobPool* pool) {
+    std::vector<uint8_t> keep(count);
+    parallelFor(pool, count, 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t s = visible[i];
+            float r = spheres.radius[s];
+            float lo[3] = { spheres.x[s] - r, spheres.y[s] - r, spheres.z[s] - r };
+            float hi[3] = { spheres.x[s] + r, spheres.y[s] + r, spheres.z[s] + r };
+            keep[i] = testOcclusionBox(buffer, lo, hi);
+        }
+    });
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        if (keep[i]) visible[n++] = visible[i];
+    return n;
+}
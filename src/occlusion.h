@@ -0,0 +1,43 @@
+#pragma once
+#include "culling.h"
+#include "job_pool.h"
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// CPU occlusion culling. A few occluder meshes are rasterized into a small depth buffer
+// (SSE edge functions, one job per screen tile), the buffer is reduced into a max-depth
+// pyramid, and object boxes are rejected when their nearest depth lies behind the farthest
+// occluder depth over the texels they cover. No GL is involved.
+
+const int OCCLUSION_TILE_SIZE = 32;
+
+struct OccluderTriangle {
+    float x[3], y[3], z[3];  // pixel coordinates and window depth in [0, 1]
+};
+
+struct OcclusionBuffer {
+    int width, height;
+    int tilesX, tilesY;
+    float viewProjection[16];
+    std::vector<OccluderTriangle> triangles;
+    std::vector<std::vector<uint32_t>> tileBins;
+    // Level 0 is the depth buffer itself; each further level keeps the max of 2x2 texels and
+    // rounds its size up, so an odd last row or column is still covered.
+    std::vector<std::vector<float>> levels;
+    std::vector<int> levelWidth, levelHeight;
+};
+
+// width and height are rounded up to whole tiles.
+OcclusionBuffer createOcclusionBuffer(int width, int height);
+void beginOcclusionFrame(OcclusionBuffer& buffer, const float* viewProjection);
+void addOccluder(OcclusionBuffer& buffer, const Mesh& mesh, const float* model);
+void rasterizeOccluders(OcclusionBuffer& buffer, JobPool* pool);
+void buildDepthPyramid(OcclusionBuffer& buffer);
+
+// False when the box is hidden behind the occluders or entirely off screen.
+bool testOcclusionBox(const OcclusionBuffer& buffer, const float* minCorner, const float* maxCorner);
+// Filters visible[0..count) in place with the box around each sphere; returns the new count.
+uint32_t cullOccludedSpheres(const OcclusionBuffer& buffer, const CullSpheres& spheres, uint32_t* visible,
+                             uint32_t count, JobPool* pool = nullptr);
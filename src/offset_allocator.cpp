@@ -0,0 +1,178 @@
+#include "offset_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t MANTISSA_BITS = 3;
+static const uint32_t MANTISSA_VALUE = 1u << MANTISSA_BITS;
+static const uint32_t MANTISSA_MASK = MANTISSA_VALUE - 1;
+static const uint32_t UNUSED = OFFSET_ALLOCATOR_NO_SPACE;
+
+static uint32_t highestBit(uint32_t v) {
+    uint32_t bit = 0;
+    while (v >>= 1) ++bit;
+    return bit;
+}
+
+static uint32_t lowestBit(uint32_t v) {
+    uint32_t bit = 0;
+    while (!(v & 1)) { v >>= 1; ++bit; }
+    return bit;
+}
+
+// Bin of the smallest size class holding at least size; used when searching.
+static uint32_t binRoundUp(uint32_t size) {
+    if (size < MANTISSA_VALUE) return size;
+    uint32_t mantissaStart = highestBit(size) - MANTISSA_BITS;
+    uint32_t bin = ((mantissaStart + 1) << MANTISSA_BITS) + ((size >> mantissaStart) & MANTISSA_MASK);
+    // A carry out of the mantissa moves into the next exponent, which is still the right bin.
+    if (size & ((1u << mantissaStart) - 1)) ++bin;
+    return bin;
+}
+
+// Bin whose size class is at most size; used when inserting free blocks.
+static uint32_t binRoundDown(uint32_t size) {
+    if (size < MANTISSA_VALUE) return size;
+    uint32_t mantissaStart = highestBit(size) - MANTISSA_BITS;
+    return ((mantissaStart + 1) << MANTISSA_BITS) + ((size >> mantissaStart) & MANTISSA_MASK);
+}
+
+static uint32_t lowestBitFrom(uint32_t mask, uint32_t start) {
+    if (start >= 32) return UNUSED;
+    uint32_t masked = mask & ~((1u << start) - 1);
+    return masked ? lowestBit(masked) : UNUSED;
+}
+
+static uint32_t insertNode(OffsetAllocator& a, uint32_t size, uint32_t offset) {
+    uint32_t bin = binRoundDown(size);
+    uint32_t top = bin >> MANTISSA_BITS, leaf = bin & MANTISSA_MASK;
+    if (a.binHeads[bin] == UNUSED) {
+        a.usedBins[top] |= 1u << leaf;
+        a.usedBinsTop |= 1u << top;
+    }
+    uint32_t index = a.freeNodes.back();
+    a.freeNodes.pop_back();
+    a.nodes[index] = { offset, size, UNUSED, a.binHeads[bin], UNUSED, UNUSED, false };
+    if (a.binHeads[bin] != UNUSED) a.nodes[a.binHeads[bin]].binPrev = index;
+    a.binHeads[bin] = index;
+    a.freeStorage += size;
+    return index;
+}
+
+static void removeNode(OffsetAllocator& a, uint32_t index) {
+    OffsetAllocatorNode& node = a.nodes[index];
+    if (node.binPrev != UNUSED) {
+        a.nodes[node.binPrev].binNext = node.binNext;
+        if (node.binNext != UNUSED) a.nodes[node.binNext].binPrev = node.binPrev;
+    } else {
+        uint32_t bin = binRoundDown(node.size);
+        a.binHeads[bin] = node.binNext;
+        if (node.binNext != UNUSED) a.nodes[node.binNext].binPrev = UNUSED;
+        if (a.binHeads[bin] == UNUSED) {
+            uint32_t top = bin >> MANTISSA_BITS;
+            a.usedBins[top] &= ~(1u << (bin & MANTISSA_MASK));
+            if (!a.usedBins[top]) a.usedBinsTop &= ~(1u << top);
+        }
+    }
+    a.freeStorage -= node.size;
+    a.freeNodes.push_back(index);
+}
+
+OffsetAllocator createOffsetAllocator(uint32_t size, uint32_t maxAllocations) {
+    OffsetAllocator allocator = {};
+    allocator.size = size;
+    allocator.nodes.resize(maxAllocations + 1);
+    resetOffsetAllocator(allocator);
+    return allocator;
+}
+
+void resetOffsetAllocator(OffsetAllocator& a) {
+    a.freeStorage = 0;
+    a.usedBinsTop = 0;
+    memset(a.usedBins, 0, sizeof(a.usedBins));
+    std::fill(a.binHeads, a.binHeads + 256, UNUSED);
+    a.freeNodes.resize(a.nodes.size());
+    // Pop order hands out node 0 first.
+    for (size_t i = 0; i < a.nodes.size(); ++i) a.freeNodes[i] = (uint32_t)(a.nodes.size() - 1 - i);
+    if (a.size > 0) insertNode(a, a.size, 0);
+}
+
+OffsetAllocation allocateOffset(OffsetAllocator& a, uint32_t size) {
+    // One spare node is needed for the remainder of the block being split.
+    if (size == 0 || a.freeNodes.empty()) return { 0, UNUSED };
+
+    uint32_t minBin = binRoundUp(size);
+    uint32_t topBin = minBin >> MANTISSA_BITS, leafBin = UNUSED;
+    if (topBin < 32 && (a.usedBinsTop & (1u << topBin))) leafBin = lowestBitFrom(a.usedBins[topBin], minBin & MANTISSA_MASK);
+    if (leafBin == UNUSED) topBin = lowestBitFrom(a.usedBinsTop, topBin + 1);
+    if (topBin != UNUSED && leafBin == UNUSED) leafBin = lowestBit(a.usedBins[topBin]);
+
+    uint32_t index = UNUSED;
+    if (leafBin != UNUSED) {
+        index = a.binHeads[topBin << MANTISSA_BITS | leafBin];
+    } else {
+        // The bins searched above only hold blocks certain to be large enough. The bin the
+        // size itself falls in may still hold one, such as the last exact fit in a full buffer.
+        for (uint32_t i = a.binHeads[binRoundDown(size)]; i != UNUSED && index == UNUSED; i = a.nodes[i].binNext)
+            if (a.nodes[i].size >= size) index = i;
+        if (index == UNUSED) return { 0, UNUSED };
+    }
+
+    OffsetAllocatorNode& node = a.nodes[index];
+    uint32_t blockSize = node.size;
+    // Unlinking through removeNode returns the node to the free stack; take it straight back.
+    removeNode(a, index);
+    a.freeNodes.pop_back();
+    node.size = size;
+    node.used = true;
+    node.binPrev = node.binNext = UNUSED;
+
+    if (blockSize > size) {
+        uint32_t remainder = insertNode(a, blockSize - size, node.offset + size);
+        OffsetAllocatorNode& split = a.nodes[index];
+        if (split.neighborNext != UNUSED) a.nodes[split.neighborNext].neighborPrev = remainder;
+        a.nodes[remainder].neighborPrev = index;
+        a.nodes[remainder].neighborNext = split.neighborNext;
+        split.neighborNext = remainder;
+    }
+    return { a.nodes[index].offset, index };
+}
+
+void freeOffset(OffsetAllocator& a, const OffsetAllocation& allocation) {
+    if (allocation.node == UNUSED) return;
+    OffsetAllocatorNode node = a.nodes[allocation.node];
+    uint32_t offset = node.offset, size = node.size;
+    if (node.neighborPrev != UNUSED && !a.nodes[node.neighborPrev].used) {
+        const OffsetAllocatorNode& prev = a.nodes[node.neighborPrev];
+        offset = prev.offset;
+        size += prev.size;
+        uint32_t prevIndex = node.neighborPrev;
+        node.neighborPrev = prev.neighborPrev;
+        removeNode(a, prevIndex);
+    }
+    if (node.neighborNext != UNUSED && !a.nodes[node.neighborNext].used) {
+        const OffsetAllocatorNode& next = a.nodes[node.neighborNext];
+        size += next.size;
+        uint32_t nextIndex = node.neighborNext;
+        node.neighborNext = next.neighborNext;
+        removeNode(a, nextIndex);
+    }
+    a.freeNodes.push_back(allocation.node);
+
+    uint32_t merged = insertNode(a, size, offset);
+    a.nodes[merged].neighborPrev = node.neighborPrev;
+    a.nodes[merged].neighborNext = node.neighborNext;
+    if (node.neighborPrev != UNUSED) a.nodes[node.neighborPrev].neighborNext = merged;
+    if (node.neighborNext != UNUSED) a.nodes[node.neighborNext].neighborPrev = merged;
+}
+
+OffsetAllocatorReport offsetAllocatorReport(const OffsetAllocator& a) {
+    OffsetAllocatorReport report = { a.freeStorage, 0 };
+    if (a.usedBinsTop) {
+        uint32_t top = highestBit(a.usedBinsTop);
+        uint32_t bin = top << MANTISSA_BITS | highestBit(a.usedBins[top]);
+        for (uint32_t i = a.binHeads[bin]; i != UNUSED; i = a.nodes[i].binNext)
+            report.largestFree = std::max(report.largestFree, a.nodes[i].size);
+    }
+    return report;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated-fit (TLSF) allocator for ranges of a GPU buffer; it hands out
+// offsets and never touches the memory itself. Free blocks sit in 256 size bins spaced
+// like a small float (5-bit exponent, 3-bit mantissa), found through a two-level bitmap,
+// so allocating and freeing are O(1). Freed blocks merge with free physical neighbours.
+// Sizes and offsets are in whatever unit the caller uses (vertices, indices, bytes).
+
+const uint32_t OFFSET_ALLOCATOR_NO_SPACE = 0xFFFFFFFFu;
+
+struct OffsetAllocation {
+    uint32_t offset;
+    uint32_t node;  // OFFSET_ALLOCATOR_NO_SPACE when the allocation failed
+};
+
+struct OffsetAllocatorNode {
+    uint32_t offset, size;
+    uint32_t binPrev, binNext;            // free list of the node's size bin
+    uint32_t neighborPrev, neighborNext;  // physically adjacent blocks
+    bool used;
+};
+
+struct OffsetAllocator {
+    uint32_t size;
+    uint32_t freeStorage;
+    uint32_t usedBinsTop;
+    uint8_t usedBins[32];
+    uint32_t binHeads[256];
+    std::vector<OffsetAllocatorNode> nodes;
+    std::vector<uint32_t> freeNodes;
+};
+
+struct OffsetAllocatorReport {
+    uint32_t totalFree;
+    uint32_t largestFree;
+};
+
+OffsetAllocator createOffsetAllocator(uint32_t size, uint32_t maxAllocations = 64 * 1024);
+// Frees everything.
+void resetOffsetAllocator(OffsetAllocator& allocator);
+OffsetAllocation allocateOffset(OffsetAllocator& allocator, uint32_t size);
+void freeOffset(OffsetAllocator& allocator, const OffsetAllocation& allocation);
+OffsetAllocatorReport offsetAllocatorReport(const OffsetAllocator& allocator);
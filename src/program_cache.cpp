@@ -0,0 +1,151 @@
+#include "program_cache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+struct ProgramCacheHeader {
+    char magic[4];
+    uint32_t format;
+    uint64_t key;
+    double compileMs;
+};
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t hashString(uint64_t hash, const char* text) {
+    // FNV-1a, including the terminator so "ab"+"c" and "a"+"bc" differ.
+    for (const char* c = text;; ++c) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+        if (!*c) return hash;
+    }
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        glDeleteShader(shader);
+        throw std::runtime_error(std::string(type == GL_VERTEX_SHADER ? "Vertex" : "Fragment") + " shader failed to compile: " + log);
+    }
+    return shader;
+}
+
+static bool linked(GLuint program) {
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    return ok == GL_TRUE;
+}
+
+static GLuint buildProgram(const char* vertexSource, const char* fragmentSource, bool retrievable) {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fs;
+    try {
+        fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    } catch (...) {
+        glDeleteShader(vs);
+        throw;
+    }
+    GLuint program = glCreateProgram();
+    if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, vs); glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs); glDeleteShader(fs);
+    if (!linked(program)) {
+        char log[1024] = {};
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        glDeleteProgram(program);
+        throw std::runtime_error(std::string("Shader program failed to link: ") + log);
+    }
+    return program;
+}
+
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource) {
+    return buildProgram(vertexSource, fragmentSource, false);
+}
+
+static GLuint loadBinary(const std::string& path, uint64_t key, double* compileMs) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return 0;
+    ProgramCacheHeader header;
+    std::vector<uint8_t> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "PBIN", 4) == 0 && header.key == key;
+    if (ok) {
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file) - (long)sizeof(header);
+        fseek(file, sizeof(header), SEEK_SET);
+        binary.resize(size > 0 ? (size_t)size : 0);
+        ok = !binary.empty() && fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!ok) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    if (!linked(program)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    *compileMs = header.compileMs;
+    return program;
+}
+
+static void storeBinary(const std::string& cacheDir, const std::string& path, GLuint program, uint64_t key, double compileMs) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    ProgramCacheHeader header = { { 'P', 'B', 'I', 'N' }, 0, key, compileMs };
+    std::vector<uint8_t> binary((size_t)length);
+    glGetProgramBinary(program, length, &length, &header.format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return;
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(binary.data(), 1, (size_t)length, file);
+    fclose(file);
+}
+
+GLuint loadCachedProgram(const std::string& cacheDir, const char* vertexSource, const char* fragmentSource,
+                         ProgramCacheResult* result) {
+    double start = nowMs();
+    ProgramCacheResult info = {};
+    bool useCache = !cacheDir.empty() && GLExt.programBinary;
+
+    GLuint program = 0;
+    uint64_t key = 14695981039346656037ull;
+    std::string path;
+    if (useCache) {
+        key = hashString(key, vertexSource);
+        key = hashString(key, fragmentSource);
+        key = hashString(key, (const char*)glGetString(GL_VENDOR));
+        key = hashString(key, (const char*)glGetString(GL_RENDERER));
+        key = hashString(key, (const char*)glGetString(GL_VERSION));
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        path = cacheDir + "/" + name;
+        program = loadBinary(path, key, &info.compileMs);
+        info.hit = program != 0;
+    }
+
+    if (!program) {
+        program = buildProgram(vertexSource, fragmentSource, useCache);
+        info.compileMs = nowMs() - start;
+        if (useCache) storeBinary(cacheDir, path, program, key, info.compileMs);
+    }
+    info.ms = nowMs() - start;
+    if (result) *result = info;
+    return program;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "gl_ext.h"
+
+#include <string>
+
+// Builds GL programs from GLSL source and keeps the driver's program binary on disk.
+// Cache files are named after a hash of the sources and the GL vendor, renderer and
+// version strings, so a driver update or a shader edit simply misses. A binary the driver
+// rejects is recompiled from source and rewritten. Compile and link errors throw with
+// the info log.
+
+struct ProgramCacheResult {
+    bool hit;          // the program came from a cached binary
+    double ms;         // time spent building the program this run
+    double compileMs;  // compile and link time recorded when the binary was written
+};
+
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource);
+// An empty cacheDir disables the cache and always compiles.
+GLuint loadCachedProgram(const std::string& cacheDir, const char* vertexSource, const char* fragmentSource,
+                         ProgramCacheResult* result = nullptr);
@@ -0,0 +1,99 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t texture, uint32_t vao, float depth) {
+    uint64_t d = (uint64_t)(std::min(std::max(depth, 0.f), 1.f) * 16777215.f);
+    return (uint64_t)(pass & 0xF) << 60 | (uint64_t)(program & 0xFF) << 52 | (uint64_t)(material & 0xFF) << 44 |
+           (uint64_t)(texture & 0x3FF) << 34 | (uint64_t)(vao & 0x3FF) << 24 | d;
+}
+
+void clearRenderQueue(RenderQueue& queue) {
+    queue.items.clear();
+}
+
+DrawItem& pushDrawItem(RenderQueue& queue) {
+    queue.items.emplace_back();
+    return queue.items.back();
+}
+
+DrawItem* pushDrawItems(RenderQueue& queue, uint32_t count) {
+    size_t first = queue.items.size();
+    queue.items.resize(first + count);
+    return queue.items.data() + first;
+}
+
+void radixSortEntries(SortEntry* entries, SortEntry* scratch, uint32_t count) {
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; ++i)
+        for (int digit = 0; digit < 8; ++digit) ++histograms[digit][(entries[i].key >> (digit * 8)) & 0xFF];
+
+    SortEntry* src = entries;
+    SortEntry* dst = scratch;
+    for (int digit = 0; digit < 8; ++digit) {
+        uint32_t* histogram = histograms[digit];
+        // A digit that is the same for every key cannot change the order.
+        if (histogram[(src[0].key >> (digit * 8)) & 0xFF] == count) continue;
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            uint32_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (uint32_t i = 0; i < count; ++i) dst[histogram[(src[i].key >> (digit * 8)) & 0xFF]++] = src[i];
+        std::swap(src, dst);
+    }
+    if (src != entries) memcpy(entries, src, count * sizeof(SortEntry));
+}
+
+void sortRenderQueue(RenderQueue& queue) {
+    uint32_t count = (uint32_t)queue.items.size();
+    queue.order.resize(count);
+    queue.scratch.resize(count);
+    for (uint32_t i = 0; i < count; ++i) queue.order[i] = { queue.items[i].key, i };
+    if (count > 1) radixSortEntries(queue.order.data(), queue.scratch.data(), count);
+}
+
+static bool sameState(const DrawItem& a, const DrawItem& b) {
+    return a.program == b.program && a.texture == b.texture && a.vao == b.vao;
+}
+
+void submitRenderQueue(RenderQueue& queue, UniformRing& uniforms, JobPool* pool) {
+    const uint32_t grain = 2048;
+    uint32_t count = (uint32_t)queue.order.size();
+    uint32_t listCount = (count + grain - 1) / grain;
+    if (queue.lists.size() < listCount) queue.lists.resize(listCount);
+    for (uint32_t l = 0; l < listCount; ++l) resetCommandList(queue.lists[l]);
+
+    // Each chunk compares its first item with the one before it, so state commands are
+    // only recorded where the sorted order actually changes state.
+    std::atomic<uint32_t> stateChanges(0);
+    parallelFor(pool, count, grain, [&](uint32_t begin, uint32_t end) {
+        CommandList& list = queue.lists[begin / grain];
+        const DrawItem* previous = begin > 0 ? &queue.items[queue.order[begin - 1].item] : nullptr;
+        uint32_t changes = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+            const DrawItem& item = queue.items[queue.order[i].item];
+            if (!previous || !sameState(*previous, item)) {
+                ++changes;
+                cmdUseProgram(list, item.program);
+                cmdBindTexture(list, 0, GL_TEXTURE_2D, item.texture);
+                cmdBindVertexArray(list, item.vao);
+            }
+            if (item.batch) {
+                cmdBatchDraw(list, item.batch, item.range, item.model);
+            } else {
+                cmdObjectBlock(list, item.model);
+                cmdDrawElements(list, item.range, item.instanceCount);
+            }
+            previous = &item;
+        }
+        stateChanges += changes;
+    });
+    queue.stateChanges = stateChanges;
+
+    replayCommandLists(queue.lists.data(), listCount, uniforms);
+}
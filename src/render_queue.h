@@ -0,0 +1,50 @@
+#pragma once
+#include "command_list.h"
+#include "indirect.h"
+#include "job_pool.h"
+#include "mesh_pool.h"
+#include "uniform_ring.h"
+
+#include <cstdint>
+#include <vector>
+
+// Draws are queued with a 64-bit sort key, radix sorted each frame and submitted in key
+// order, so items sharing a pass, program, material, texture and VAO end up adjacent and
+// state changes happen once per group. Submission records the sorted items into one command
+// list per chunk on the job pool and replays the lists on the GL thread; a run of items that
+// share a DrawBatch VAO goes out as one multi-draw. Key layout, most significant first:
+//   pass 4 | program 8 | material 8 | texture 10 | vao 10 | depth 24
+// The ids are small slots chosen by the caller, not GL names.
+
+struct DrawItem {
+    uint64_t key;
+    GLuint program, texture, vao;
+    DrawBatch* batch;        // set when the VAO belongs to a DrawBatch; the item joins its multi-draw
+    MeshRange range;
+    uint32_t instanceCount;  // for direct draws; batch draws are single instances
+    float model[16];         // ObjectBlock model, or the per-draw transform for batch items
+};
+
+struct SortEntry {
+    uint64_t key;
+    uint32_t item;
+};
+
+struct RenderQueue {
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> order, scratch;
+    std::vector<CommandList> lists;
+    uint32_t stateChanges;   // program/texture/VAO switches made by the last submit
+};
+
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t texture, uint32_t vao, float depth);
+
+void clearRenderQueue(RenderQueue& queue);
+DrawItem& pushDrawItem(RenderQueue& queue);
+// Appends count items for the caller to fill, e.g. from a parallelFor.
+DrawItem* pushDrawItems(RenderQueue& queue, uint32_t count);
+// LSD radix sort on 8-bit digits; buffers only grow, so a steady-state frame never allocates.
+void sortRenderQueue(RenderQueue& queue);
+void submitRenderQueue(RenderQueue& queue, UniformRing& uniforms, JobPool* pool);
+
+void radixSortEntries(SortEntry* entries, SortEntry* scratch, uint32_t count);
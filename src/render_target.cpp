@@ -0,0 +1,92 @@
+#include "render_target.h"
+
+#include "gl_state.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+RenderTarget createRenderTarget(int width, int height) {
+    RenderTarget target = {};
+    target.width = width;
+    target.height = height;
+
+    glGenTextures(1, &target.color);
+    cachedBindTexture(0, GL_TEXTURE_2D, target.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenRenderbuffers(1, &target.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        freeRenderTarget(target);
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+    }
+    return target;
+}
+
+void freeRenderTarget(RenderTarget& target) {
+    if (target.fbo) glDeleteFramebuffers(1, &target.fbo);
+    if (target.depth) glDeleteRenderbuffers(1, &target.depth);
+    if (target.color) cachedDeleteTextures(1, &target.color);
+    target = {};
+}
+
+void bindRenderTarget(const RenderTarget& target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glViewport(0, 0, target.width, target.height);
+}
+
+void readRenderTarget(const RenderTarget& target, std::vector<uint8_t>& rgb) {
+    size_t row = (size_t)target.width * 3;
+    std::vector<uint8_t> flipped(row * target.height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.width, target.height, GL_RGB, GL_UNSIGNED_BYTE, flipped.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // GL rows start at the bottom.
+    rgb.resize(flipped.size());
+    for (int y = 0; y < target.height; ++y)
+        memcpy(&rgb[(size_t)y * row], &flipped[(size_t)(target.height - 1 - y) * row], row);
+}
+
+bool writeImage(const char* path, int width, int height, const uint8_t* rgb) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    size_t length = strlen(path);
+    size_t row = (size_t)width * 3;
+    if (length > 4 && strcmp(path + length - 4, ".tga") == 0) {
+        // Uncompressed true-colour TGA with the origin at the top left, pixels stored as BGR.
+        uint8_t header[18] = {};
+        header[2] = 2;
+        header[12] = width & 0xFF; header[13] = (width >> 8) & 0xFF;
+        header[14] = height & 0xFF; header[15] = (height >> 8) & 0xFF;
+        header[16] = 24;
+        header[17] = 0x20;
+        fwrite(header, 1, sizeof(header), file);
+        std::vector<uint8_t> bgr(row);
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* src = rgb + (size_t)y * row;
+            for (size_t x = 0; x < row; x += 3) {
+                bgr[x] = src[x + 2]; bgr[x + 1] = src[x + 1]; bgr[x + 2] = src[x];
+            }
+            fwrite(bgr.data(), 1, row, file);
+        }
+    } else {
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        fwrite(rgb, 1, row * height, file);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
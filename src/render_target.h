@@ -0,0 +1,22 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+// Offscreen framebuffer with an RGBA8 colour texture and a depth renderbuffer.
+
+struct RenderTarget {
+    GLuint fbo, color, depth;
+    int width, height;
+};
+
+RenderTarget createRenderTarget(int width, int height);
+void freeRenderTarget(RenderTarget& target);
+// Binds the target for drawing and sets the viewport to cover it.
+void bindRenderTarget(const RenderTarget& target);
+// Reads the colour buffer as tightly packed RGB rows, top row first.
+void readRenderTarget(const RenderTarget& target, std::vector<uint8_t>& rgb);
+
+// Writes RGB pixels as binary PPM, or as uncompressed TGA when the path ends in .tga.
+bool writeImage(const char* path, int width, int height, const uint8_t* rgb);
@@ -0,0 +1,230 @@
+#include "scene_graph.h"
+
+#include "matrix.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static const uint32_t SCENE_GRAIN = 2048;
+static bool forceScalar = false;
+
+SceneGraph createSceneGraph(const std::vector<SceneNodeDesc>& nodes, std::vector<uint32_t>* remap) {
+    uint32_t count = (uint32_t)nodes.size();
+    std::vector<uint32_t> childStart(count + 1, 0), children(count), roots;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t p = nodes[i].parent;
+        if (p == SCENE_NO_PARENT) {
+            roots.push_back(i);
+        } else {
+            if (p >= i) throw std::runtime_error("Scene node parent must come before the node");
+            ++childStart[p + 1];
+        }
+    }
+    for (uint32_t i = 0; i < count; ++i) childStart[i + 1] += childStart[i];
+    std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+    for (uint32_t i = 0; i < count; ++i)
+        if (nodes[i].parent != SCENE_NO_PARENT) children[fill[nodes[i].parent]++] = i;
+
+    // Breadth-first order puts each level in one range and each node's children side by side.
+    std::vector<uint32_t> order(roots), toNode(count);
+    order.reserve(count);
+    for (size_t i = 0; i < order.size(); ++i) {
+        uint32_t d = order[i];
+        order.insert(order.end(), children.begin() + childStart[d], children.begin() + childStart[d + 1]);
+    }
+    for (uint32_t i = 0; i < count; ++i) toNode[order[i]] = i;
+
+    SceneGraph graph = {};
+    graph.parent.resize(count); graph.firstChild.resize(count); graph.childCount.resize(count);
+    graph.depth.resize(count);
+    graph.tx.resize(count); graph.ty.resize(count); graph.tz.resize(count);
+    graph.qx.resize(count); graph.qy.resize(count); graph.qz.resize(count); graph.qw.resize(count);
+    graph.scale.resize(count);
+    graph.world.resize((size_t)count * 16);
+    graph.dirty.assign(count, 0);
+    graph.visited.assign(count, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        const SceneNodeDesc& desc = nodes[order[i]];
+        uint32_t d = order[i];
+        graph.parent[i] = desc.parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : toNode[desc.parent];
+        graph.depth[i] = desc.parent == SCENE_NO_PARENT ? 0 : graph.depth[graph.parent[i]] + 1;
+        graph.childCount[i] = childStart[d + 1] - childStart[d];
+        graph.firstChild[i] = graph.childCount[i] ? toNode[children[childStart[d]]] : 0;
+        graph.tx[i] = desc.translation[0]; graph.ty[i] = desc.translation[1]; graph.tz[i] = desc.translation[2];
+        graph.qx[i] = desc.rotation[0]; graph.qy[i] = desc.rotation[1];
+        graph.qz[i] = desc.rotation[2]; graph.qw[i] = desc.rotation[3];
+        graph.scale[i] = desc.scale;
+    }
+
+    uint32_t levels = count ? graph.depth[count - 1] + 1 : 0;
+    graph.levelStart.assign(levels + 1, count);
+    for (uint32_t i = count; i-- > 0;) graph.levelStart[graph.depth[i]] = i;
+    graph.dirtyByLevel.resize(levels);
+    // Dirty roots pull in every subtree on the first update.
+    for (uint32_t i = 0; i < (uint32_t)roots.size(); ++i) {
+        graph.dirty[i] = 1;
+        graph.dirtyByLevel[0].push_back(i);
+    }
+
+    if (remap) *remap = toNode;
+    return graph;
+}
+
+void setLocalTransform(SceneGraph& graph, uint32_t node, const float* translation, const float* rotation, float scale) {
+    graph.tx[node] = translation[0]; graph.ty[node] = translation[1]; graph.tz[node] = translation[2];
+    graph.qx[node] = rotation[0]; graph.qy[node] = rotation[1]; graph.qz[node] = rotation[2]; graph.qw[node] = rotation[3];
+    graph.scale[node] = scale;
+    if (!graph.dirty[node]) {
+        graph.dirty[node] = 1;
+        graph.dirtyByLevel[graph.depth[node]].push_back(node);
+    }
+}
+
+// The world matrices of nodes are affine, so parent * local only needs the upper 3x4.
+static void composeWorld(SceneGraph& graph, uint32_t node, const float* local) {
+    float* out = &graph.world[(size_t)node * 16];
+    uint32_t p = graph.parent[node];
+    if (p == SCENE_NO_PARENT) {
+        std::copy(local, local + 16, out);
+        return;
+    }
+    const float* pw = &graph.world[(size_t)p * 16];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 3; ++r)
+            out[c * 4 + r] = pw[r] * local[c * 4] + pw[4 + r] * local[c * 4 + 1] + pw[8 + r] * local[c * 4 + 2]
+                + (c == 3 ? pw[12 + r] : 0.f);
+        out[c * 4 + 3] = c == 3 ? 1.f : 0.f;
+    }
+}
+
+static void localMatrix(const SceneGraph& graph, uint32_t i, float* m) {
+    float x = graph.qx[i], y = graph.qy[i], z = graph.qz[i], w = graph.qw[i];
+    float s = graph.scale[i], s2 = s * 2.f;
+    m[0] = s - s2 * (y * y + z * z); m[1] = s2 * (x * y + w * z); m[2] = s2 * (x * z - w * y); m[3] = 0.f;
+    m[4] = s2 * (x * y - w * z); m[5] = s - s2 * (x * x + z * z); m[6] = s2 * (y * z + w * x); m[7] = 0.f;
+    m[8] = s2 * (x * z + w * y); m[9] = s2 * (y * z - w * x); m[10] = s - s2 * (x * x + y * y); m[11] = 0.f;
+    m[12] = graph.tx[i]; m[13] = graph.ty[i]; m[14] = graph.tz[i]; m[15] = 1.f;
+}
+
+// nodes == nullptr means the contiguous range starting at first.
+static void composeScalar(SceneGraph& graph, const uint32_t* nodes, uint32_t first, uint32_t count) {
+    float local[16];
+    for (uint32_t k = 0; k < count; ++k) {
+        uint32_t node = nodes ? nodes[k] : first + k;
+        localMatrix(graph, node, local);
+        composeWorld(graph, node, local);
+    }
+}
+
+#ifdef MATRIX_SSE
+static void composeSSE(SceneGraph& graph, const uint32_t* nodes, uint32_t first, uint32_t count) {
+    uint32_t k = 0;
+    alignas(16) float local[12][4];  // row-major 3x4 per lane: rotation-scale columns then translation
+    for (; k + 4 <= count; k += 4) {
+        uint32_t n[4];
+        for (int lane = 0; lane < 4; ++lane) n[lane] = nodes ? nodes[k + lane] : first + k + lane;
+        auto gather = [&](const std::vector<float>& a) { return _mm_setr_ps(a[n[0]], a[n[1]], a[n[2]], a[n[3]]); };
+        __m128 x = gather(graph.qx), y = gather(graph.qy), z = gather(graph.qz), w = gather(graph.qw);
+        __m128 s = gather(graph.scale), s2 = _mm_add_ps(s, s);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        _mm_store_ps(local[0], _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(yy, zz))));
+        _mm_store_ps(local[1], _mm_mul_ps(s2, _mm_add_ps(xy, wz)));
+        _mm_store_ps(local[2], _mm_mul_ps(s2, _mm_sub_ps(xz, wy)));
+        _mm_store_ps(local[3], _mm_mul_ps(s2, _mm_sub_ps(xy, wz)));
+        _mm_store_ps(local[4], _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(xx, zz))));
+        _mm_store_ps(local[5], _mm_mul_ps(s2, _mm_add_ps(yz, wx)));
+        _mm_store_ps(local[6], _mm_mul_ps(s2, _mm_add_ps(xz, wy)));
+        _mm_store_ps(local[7], _mm_mul_ps(s2, _mm_sub_ps(yz, wx)));
+        _mm_store_ps(local[8], _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(xx, yy))));
+        _mm_store_ps(local[9], gather(graph.tx));
+        _mm_store_ps(local[10], gather(graph.ty));
+        _mm_store_ps(local[11], gather(graph.tz));
+
+        for (int lane = 0; lane < 4; ++lane) {
+            float* out = &graph.world[(size_t)n[lane] * 16];
+            __m128 c0 = _mm_setr_ps(local[0][lane], local[1][lane], local[2][lane], 0.f);
+            __m128 c1 = _mm_setr_ps(local[3][lane], local[4][lane], local[5][lane], 0.f);
+            __m128 c2 = _mm_setr_ps(local[6][lane], local[7][lane], local[8][lane], 0.f);
+            __m128 c3 = _mm_setr_ps(local[9][lane], local[10][lane], local[11][lane], 1.f);
+            uint32_t p = graph.parent[n[lane]];
+            if (p != SCENE_NO_PARENT) {
+                const float* pw = &graph.world[(size_t)p * 16];
+                __m128 p0 = _mm_loadu_ps(pw), p1 = _mm_loadu_ps(pw + 4), p2 = _mm_loadu_ps(pw + 8), p3 = _mm_loadu_ps(pw + 12);
+                auto transform = [&](const float* l) {
+                    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(l[0])), _mm_mul_ps(p1, _mm_set1_ps(l[1]))),
+                        _mm_mul_ps(p2, _mm_set1_ps(l[2])));
+                };
+                float l0[3] = { local[0][lane], local[1][lane], local[2][lane] };
+                float l1[3] = { local[3][lane], local[4][lane], local[5][lane] };
+                float l2[3] = { local[6][lane], local[7][lane], local[8][lane] };
+                float l3[3] = { local[9][lane], local[10][lane], local[11][lane] };
+                c0 = transform(l0);
+                c1 = transform(l1);
+                c2 = transform(l2);
+                c3 = _mm_add_ps(transform(l3), p3);
+            }
+            _mm_storeu_ps(out, c0);
+            _mm_storeu_ps(out + 4, c1);
+            _mm_storeu_ps(out + 8, c2);
+            _mm_storeu_ps(out + 12, c3);
+        }
+    }
+    composeScalar(graph, nodes ? nodes + k : nullptr, first + k, count - k);
+}
+#endif
+
+static void composeNodes(SceneGraph& graph, const uint32_t* nodes, uint32_t first, uint32_t count, JobPool* pool) {
+    parallelFor(pool, count, SCENE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        const uint32_t* subset = nodes ? nodes + begin : nullptr;
+#ifdef MATRIX_SSE
+        if (!forceScalar) {
+            composeSSE(graph, subset, first + begin, end - begin);
+            return;
+        }
+#endif
+        composeScalar(graph, subset, first + begin, end - begin);
+    });
+}
+
+uint32_t updateSceneGraph(SceneGraph& graph, JobPool* pool) {
+    if (++graph.frame == 0) {
+        std::fill(graph.visited.begin(), graph.visited.end(), 0u);
+        graph.frame = 1;
+    }
+    uint32_t updated = 0;
+    graph.work.clear();
+    for (uint32_t d = 0; d < (uint32_t)graph.dirtyByLevel.size(); ++d) {
+        // This level's work is every child of the last level's work plus the nodes changed here.
+        graph.nextWork.clear();
+        for (uint32_t p : graph.work) {
+            for (uint32_t c = graph.firstChild[p], end = c + graph.childCount[p]; c < end; ++c) {
+                graph.visited[c] = graph.frame;
+                graph.nextWork.push_back(c);
+            }
+        }
+        for (uint32_t node : graph.dirtyByLevel[d]) {
+            graph.dirty[node] = 0;
+            if (graph.visited[node] != graph.frame) {
+                graph.visited[node] = graph.frame;
+                graph.nextWork.push_back(node);
+            }
+        }
+        graph.dirtyByLevel[d].clear();
+        std::swap(graph.work, graph.nextWork);
+        composeNodes(graph, graph.work.data(), 0, (uint32_t)graph.work.size(), pool);
+        updated += (uint32_t)graph.work.size();
+    }
+    return updated;
+}
+
+void updateAllSceneGraph(SceneGraph& graph, JobPool* pool) {
+    for (uint32_t d = 0; d < (uint32_t)graph.dirtyByLevel.size(); ++d) {
+        for (uint32_t node : graph.dirtyByLevel[d]) graph.dirty[node] = 0;
+        graph.dirtyByLevel[d].clear();
+        composeNodes(graph, nullptr, graph.levelStart[d], graph.levelStart[d + 1] - graph.levelStart[d], pool);
+    }
+}
+
+void sceneGraphForceScalar(bool scalar) { forceScalar = scalar; }
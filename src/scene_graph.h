@@ -0,0 +1,48 @@
+#pragma once
+#include "job_pool.h"
+
+#include <cstdint>
+#include <vector>
+
+// Transform hierarchy stored as arrays sorted by depth: every node sits after its parent
+// and a node's children are contiguous, so one forward sweep per level computes world
+// matrices. Local transforms are translation, rotation quaternion and uniform scale in
+// separate arrays. Changing a node marks it dirty, and updateSceneGraph recomputes only
+// the dirty nodes and their subtrees, level by level, spreading each level over the job
+// pool and building four local matrices at a time with SSE.
+
+const uint32_t SCENE_NO_PARENT = 0xFFFFFFFFu;
+
+struct SceneNodeDesc {
+    uint32_t parent;  // index into the desc array, lower than the node's own, or SCENE_NO_PARENT
+    float translation[3];
+    float rotation[4];  // quaternion x, y, z, w
+    float scale;
+};
+
+struct SceneGraph {
+    std::vector<uint32_t> parent, firstChild, childCount;
+    std::vector<uint32_t> depth;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> scale;
+    std::vector<float> world;  // 16 floats per node, column-major
+    std::vector<uint32_t> levelStart;  // depth d holds nodes [levelStart[d], levelStart[d + 1])
+    std::vector<uint8_t> dirty;
+    std::vector<std::vector<uint32_t>> dirtyByLevel;
+    std::vector<uint32_t> visited;  // frame stamp, so a node joins a level's work once
+    uint32_t frame;
+    std::vector<uint32_t> work, nextWork;
+};
+
+// Reorders the nodes by depth; remap, when given, receives each desc's node index.
+// Every node starts dirty.
+SceneGraph createSceneGraph(const std::vector<SceneNodeDesc>& nodes, std::vector<uint32_t>* remap = nullptr);
+// Not thread-safe; call between updates.
+void setLocalTransform(SceneGraph& graph, uint32_t node, const float* translation, const float* rotation, float scale);
+// Returns the number of world matrices recomputed.
+uint32_t updateSceneGraph(SceneGraph& graph, JobPool* pool);
+// Recomputes every world matrix in one sweep, ignoring the dirty flags.
+void updateAllSceneGraph(SceneGraph& graph, JobPool* pool);
+inline const float* worldMatrix(const SceneGraph& graph, uint32_t node) { return &graph.world[(size_t)node * 16]; }
+void sceneGraphForceScalar(bool scalar);
@@ -0,0 +1,18 @@
+#pragma once
+#include <glad/glad.h>
+
+// std140 layouts of the uniform blocks declared by the viewer's shaders.
+
+struct FrameUniforms {
+    float view[16];
+    float projection[16];
+    float lightDir[4];
+    float clusterScale[4];  // see clusterFrameParams
+};
+struct ObjectUniforms {
+    float model[16];
+    float normalMatrix[12];
+};
+
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
@@ -0,0 +1,277 @@
+#include "soft_raster.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SOFT_SSE 1
+#include <emmintrin.h>
+#endif
+
+struct SoftVertex {
+    float clip[4];
+    float normal[3];
+    float uv[2];
+};
+
+SoftRenderer createSoftRenderer(int width, int height) {
+    SoftRenderer renderer = {};
+    renderer.width = width;
+    renderer.height = height;
+    renderer.depthStride = (width + 3) & ~3;
+    renderer.tilesX = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    renderer.tilesY = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    renderer.color.resize((size_t)width * height * 3);
+    renderer.depth.resize((size_t)renderer.depthStride * height);
+    renderer.bins.resize((size_t)renderer.tilesX * renderer.tilesY);
+    return renderer;
+}
+
+void softBeginFrame(SoftRenderer& renderer, const FrameUniforms& frame, const float clearColor[3]) {
+    renderer.frame = frame;
+    memcpy(renderer.clearColor, clearColor, sizeof(renderer.clearColor));
+    renderer.draws.clear();
+    renderer.stats = {};
+}
+
+void softDrawMesh(SoftRenderer& renderer, const Mesh& mesh, const SoftTexture& texture, const ObjectUniforms& object) {
+    renderer.draws.push_back({ &mesh, &texture, object });
+    renderer.stats.trianglesSubmitted += mesh.indexCount / 3;
+}
+
+static SoftVertex lerpVertex(const SoftVertex& a, const SoftVertex& b, float t) {
+    SoftVertex v;
+    for (int i = 0; i < 4; ++i) v.clip[i] = a.clip[i] + (b.clip[i] - a.clip[i]) * t;
+    for (int i = 0; i < 3; ++i) v.normal[i] = a.normal[i] + (b.normal[i] - a.normal[i]) * t;
+    for (int i = 0; i < 2; ++i) v.uv[i] = a.uv[i] + (b.uv[i] - a.uv[i]) * t;
+    return v;
+}
+
+// Screen-space setup: barycentric planes normalized so the inside is >= 0 for either winding
+// (the GL path draws without face culling), plus planes for every interpolated value.
+static void setupTriangle(const SoftRenderer& r, const SoftVertex* v[3], const SoftTexture* texture,
+                          std::vector<SoftTriangle>& out) {
+    float x[3], y[3], attributes[3][7];
+    for (int i = 0; i < 3; ++i) {
+        float invW = 1.f / v[i]->clip[3];
+        x[i] = (v[i]->clip[0] * invW * 0.5f + 0.5f) * r.width;
+        y[i] = (0.5f - v[i]->clip[1] * invW * 0.5f) * r.height;
+        float* a = attributes[i];
+        a[0] = v[i]->clip[2] * invW * 0.5f + 0.5f;
+        a[1] = invW;
+        a[2] = v[i]->uv[0] * invW; a[3] = v[i]->uv[1] * invW;
+        a[4] = v[i]->normal[0] * invW; a[5] = v[i]->normal[1] * invW; a[6] = v[i]->normal[2] * invW;
+    }
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(fabsf(area) > 1e-8f)) return;
+
+    SoftTriangle t;
+    t.minX = std::max(0, (int)floorf(std::min({ x[0], x[1], x[2] })));
+    t.minY = std::max(0, (int)floorf(std::min({ y[0], y[1], y[2] })));
+    t.maxX = std::min(r.width - 1, (int)ceilf(std::max({ x[0], x[1], x[2] })));
+    t.maxY = std::min(r.height - 1, (int)ceilf(std::max({ y[0], y[1], y[2] })));
+    if (t.minX > t.maxX || t.minY > t.maxY) return;
+    t.texture = texture;
+
+    for (int i = 0; i < 3; ++i) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        // Edge a->b is opposite vertex i; dividing by the signed area makes it the barycentric of i.
+        t.planes[i][0] = -(y[b] - y[a]) / area;
+        t.planes[i][1] = (x[b] - x[a]) / area;
+        t.planes[i][2] = ((y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a]) / area;
+    }
+    for (int k = 0; k < 7; ++k)
+        for (int c = 0; c < 3; ++c)
+            t.planes[3 + k][c] = t.planes[0][c] * attributes[0][k] + t.planes[1][c] * attributes[1][k] + t.planes[2][c] * attributes[2][k];
+    out.push_back(t);
+}
+
+static void clipAndSetup(const SoftRenderer& r, const SoftVertex& a, const SoftVertex& b, const SoftVertex& c,
+                         const SoftTexture* texture, std::vector<SoftTriangle>& out) {
+    const SoftVertex* in[3] = { &a, &b, &c };
+    // Trivially reject triangles entirely outside one frustum plane.
+    for (int axis = 0; axis < 3; ++axis) {
+        bool allBelow = true, allAbove = true;
+        for (const SoftVertex* v : in) {
+            allBelow = allBelow && v->clip[axis] < -v->clip[3];
+            allAbove = allAbove && v->clip[axis] > v->clip[3];
+        }
+        if (allBelow || allAbove) return;
+    }
+
+    // Clip against the near plane (z >= -w); the others are handled by the screen bounds
+    // and the depth range test.
+    float distance[3];
+    int inside = 0;
+    for (int i = 0; i < 3; ++i) {
+        distance[i] = in[i]->clip[2] + in[i]->clip[3];
+        inside += distance[i] >= 0.f;
+    }
+    if (inside == 3) { setupTriangle(r, in, texture, out); return; }
+
+    SoftVertex polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        if (distance[i] >= 0.f) polygon[count++] = *in[i];
+        if ((distance[i] >= 0.f) != (distance[j] >= 0.f))
+            polygon[count++] = lerpVertex(*in[i], *in[j], distance[i] / (distance[i] - distance[j]));
+    }
+    for (int i = 1; i + 1 < count; ++i) {
+        const SoftVertex* fan[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+        setupTriangle(r, fan, texture, out);
+    }
+}
+
+static void transformDraw(const SoftRenderer& r, const SoftDraw& draw, std::vector<SoftTriangle>& out) {
+    static thread_local std::vector<SoftVertex> vertices;
+    const Mesh& mesh = *draw.mesh;
+    float viewProjection[16], mvp[16];
+    mat4_mul(viewProjection, r.frame.projection, r.frame.view);
+    mat4_mul(mvp, viewProjection, draw.object.model);
+    const float* n = draw.object.normalMatrix;
+
+    vertices.resize(mesh.vertexCount);
+    for (uint32_t i = 0; i < mesh.vertexCount; ++i) {
+        const Vertex& src = mesh.vertices[i];
+        SoftVertex& v = vertices[i];
+        float p[3] = { src.position.x, src.position.y, src.position.z };
+        for (int row = 0; row < 4; ++row)
+            v.clip[row] = mvp[row] * p[0] + mvp[4 + row] * p[1] + mvp[8 + row] * p[2] + mvp[12 + row];
+        for (int row = 0; row < 3; ++row)
+            v.normal[row] = n[row] * src.normal.x + n[4 + row] * src.normal.y + n[8 + row] * src.normal.z;
+        v.uv[0] = src.texcoords.x;
+        v.uv[1] = src.texcoords.y;
+    }
+    out.clear();
+    for (uint32_t i = 0; i + 2 < mesh.indexCount; i += 3)
+        clipAndSetup(r, vertices[mesh.indices[i]], vertices[mesh.indices[i + 1]], vertices[mesh.indices[i + 2]], draw.texture, out);
+}
+
+static void sampleBilinear(const SoftTexture& texture, float u, float v, float rgb[3]) {
+    // GL_REPEAT wrapping with texel centres at half-integer coordinates, as the GL path samples.
+    float fx = u * texture.width - 0.5f, fy = v * texture.height - 0.5f;
+    float x0f = floorf(fx), y0f = floorf(fy);
+    float tx = fx - x0f, ty = fy - y0f;
+    int x0 = (int)x0f % texture.width, y0 = (int)y0f % texture.height;
+    if (x0 < 0) x0 += texture.width;
+    if (y0 < 0) y0 += texture.height;
+    int x1 = (x0 + 1) % texture.width, y1 = (y0 + 1) % texture.height;
+    const uint8_t* row0 = &texture.rgb[(size_t)y0 * texture.width * 3];
+    const uint8_t* row1 = &texture.rgb[(size_t)y1 * texture.width * 3];
+    for (int c = 0; c < 3; ++c) {
+        float top = row0[x0 * 3 + c] + (row0[x1 * 3 + c] - row0[x0 * 3 + c]) * tx;
+        float bottom = row1[x0 * 3 + c] + (row1[x1 * 3 + c] - row1[x0 * 3 + c]) * tx;
+        rgb[c] = (top + (bottom - top) * ty) * (1.f / 255.f);
+    }
+}
+
+static inline float plane(const float p[3], float x, float y) {
+    return p[0] * x + p[1] * y + p[2];
+}
+
+static void shadePixel(SoftRenderer& r, const SoftTriangle& t, const float light[3], int x, int y) {
+    float px = x + 0.5f, py = y + 0.5f;
+    float w = 1.f / plane(t.planes[4], px, py);
+    float u = plane(t.planes[5], px, py) * w, v = plane(t.planes[6], px, py) * w;
+    float n[3] = { plane(t.planes[7], px, py) * w, plane(t.planes[8], px, py) * w, plane(t.planes[9], px, py) * w };
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float diff = length > 0.f ? std::max((n[0] * light[0] + n[1] * light[1] + n[2] * light[2]) / length, 0.f) : 0.f;
+    float texel[3];
+    sampleBilinear(*t.texture, u, v, texel);
+    uint8_t* out = &r.color[((size_t)y * r.width + x) * 3];
+    for (int c = 0; c < 3; ++c) out[c] = (uint8_t)(std::min(diff * texel[c], 1.f) * 255.f + 0.5f);
+}
+
+static uint64_t rasterizeTile(SoftRenderer& r, int tile, const float light[3]) {
+    int x0 = (tile % r.tilesX) * SOFT_TILE_SIZE, y0 = (tile / r.tilesX) * SOFT_TILE_SIZE;
+    int x1 = std::min(x0 + SOFT_TILE_SIZE, r.width) - 1, y1 = std::min(y0 + SOFT_TILE_SIZE, r.height) - 1;
+
+    uint8_t clear[3];
+    for (int c = 0; c < 3; ++c) clear[c] = (uint8_t)(std::min(std::max(r.clearColor[c], 0.f), 1.f) * 255.f + 0.5f);
+    for (int y = y0; y <= y1; ++y) {
+        std::fill(&r.depth[(size_t)y * r.depthStride + x0], &r.depth[(size_t)y * r.depthStride + x1 + 1], 1.f);
+        for (int x = x0; x <= x1; ++x) memcpy(&r.color[((size_t)y * r.width + x) * 3], clear, 3);
+    }
+
+    uint64_t shaded = 0;
+    for (const SoftTriangle* t : r.bins[tile]) {
+        int minX = std::max(t->minX, x0) & ~3, maxX = std::min(t->maxX, x1);
+        int minY = std::max(t->minY, y0), maxY = std::min(t->maxY, y1);
+        for (int y = minY; y <= maxY; ++y) {
+            float py = y + 0.5f;
+            float* depthRow = &r.depth[(size_t)y * r.depthStride];
+#ifdef SOFT_SSE
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), steps = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 rowB[3], stepB[3];
+            for (int i = 0; i < 3; ++i) {
+                rowB[i] = _mm_set1_ps(t->planes[i][1] * py + t->planes[i][2]);
+                stepB[i] = _mm_set1_ps(t->planes[i][0]);
+            }
+            __m128 rowZ = _mm_set1_ps(t->planes[3][1] * py + t->planes[3][2]), stepZ = _mm_set1_ps(t->planes[3][0]);
+            for (int x = minX; x <= maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), steps);
+                __m128 b0 = _mm_add_ps(_mm_mul_ps(stepB[0], px), rowB[0]);
+                __m128 b1 = _mm_add_ps(_mm_mul_ps(stepB[1], px), rowB[1]);
+                __m128 b2 = _mm_add_ps(_mm_mul_ps(stepB[2], px), rowB[2]);
+                __m128 z = _mm_add_ps(_mm_mul_ps(stepZ, px), rowZ);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(b0, zero), _mm_cmpge_ps(b1, zero)), _mm_cmpge_ps(b2, zero));
+                __m128 stored = _mm_loadu_ps(depthRow + x);
+                __m128 pass = _mm_and_ps(inside, _mm_and_ps(_mm_cmplt_ps(z, stored), _mm_cmple_ps(z, one)));
+                int mask = _mm_movemask_ps(pass);
+                // Lanes outside the tile belong to a neighbouring tile's thread.
+                if (x < x0) mask &= 0xF << (x0 - x);
+                if (x + 3 > x1) mask &= 0xF >> (x + 3 - x1);
+                if (!mask) continue;
+                __m128 keep = _mm_castsi128_ps(_mm_setr_epi32(mask & 1 ? -1 : 0, mask & 2 ? -1 : 0, mask & 4 ? -1 : 0, mask & 8 ? -1 : 0));
+                _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(keep, z), _mm_andnot_ps(keep, stored)));
+                for (int lane = 0; lane < 4; ++lane)
+                    if (mask & (1 << lane)) { shadePixel(r, *t, light, x + lane, y); ++shaded; }
+            }
+#else
+            for (int x = std::max(minX, x0); x <= maxX; ++x) {
+                float px = x + 0.5f;
+                if (plane(t->planes[0], px, py) < 0.f || plane(t->planes[1], px, py) < 0.f || plane(t->planes[2], px, py) < 0.f) continue;
+                float z = plane(t->planes[3], px, py);
+                if (!(z < depthRow[x]) || z > 1.f) continue;
+                depthRow[x] = z;
+                shadePixel(r, *t, light, x, y);
+                ++shaded;
+            }
+#endif
+        }
+    }
+    return shaded;
+}
+
+void softEndFrame(SoftRenderer& r, JobPool* pool) {
+    uint32_t drawCount = (uint32_t)r.draws.size();
+    if (r.drawTriangles.size() < drawCount) r.drawTriangles.resize(drawCount);
+    parallelFor(pool, drawCount, 16, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) transformDraw(r, r.draws[i], r.drawTriangles[i]);
+    });
+
+    // Binning stays serial so every tile sees its triangles in submission order.
+    for (std::vector<const SoftTriangle*>& bin : r.bins) bin.clear();
+    for (uint32_t i = 0; i < drawCount; ++i) {
+        for (const SoftTriangle& t : r.drawTriangles[i]) {
+            for (int ty = t.minY / SOFT_TILE_SIZE; ty <= t.maxY / SOFT_TILE_SIZE; ++ty)
+                for (int tx = t.minX / SOFT_TILE_SIZE; tx <= t.maxX / SOFT_TILE_SIZE; ++tx)
+                    r.bins[(size_t)ty * r.tilesX + tx].push_back(&t);
+        }
+        r.stats.trianglesRasterized += r.drawTriangles[i].size();
+    }
+
+    const float* d = r.frame.lightDir;
+    float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    float light[3] = { -d[0] / length, -d[1] / length, -d[2] / length };
+    std::atomic<uint64_t> shaded(0);
+    parallelFor(pool, (uint32_t)r.bins.size(), 1, [&](uint32_t begin, uint32_t end) {
+        uint64_t count = 0;
+        for (uint32_t tile = begin; tile < end; ++tile) count += rasterizeTile(r, (int)tile, light);
+        shaded += count;
+    });
+    r.stats.pixelsShaded = shaded;
+}
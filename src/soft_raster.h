@@ -0,0 +1,57 @@
+#pragma once
+#include "job_pool.h"
+#include "mesh.h"
+#include "shader_blocks.h"
+
+#include <cstdint>
+#include <vector>
+
+// CPU renderer for the viewer's scene: the same Mesh, texture, FrameUniforms and
+// ObjectUniforms as the GL path, with Lambert lighting and bilinear sampling matching
+// fragmentShaderSource. Draws are queued, then softEndFrame transforms and clips them on the
+// job pool, bins the triangles into 64x64 tiles and rasterizes the tiles in parallel,
+// testing four pixels at a time with SSE edge functions against a float depth buffer.
+
+const int SOFT_TILE_SIZE = 64;
+
+// RGB8 texels with the bottom row first, the same orientation the GL path uploads.
+struct SoftTexture {
+    int width, height;
+    std::vector<uint8_t> rgb;
+};
+
+struct SoftTriangle {
+    float planes[10][3];  // a*x + b*y + c for b0, b1, b2, z, 1/w, u/w, v/w, nx/w, ny/w, nz/w
+    int minX, minY, maxX, maxY;
+    const SoftTexture* texture;
+};
+
+struct SoftDraw {
+    const Mesh* mesh;
+    const SoftTexture* texture;
+    ObjectUniforms object;
+};
+
+struct SoftRasterStats {
+    uint64_t trianglesSubmitted;
+    uint64_t trianglesRasterized;  // after clipping and rejecting degenerate or off-screen triangles
+    uint64_t pixelsShaded;
+};
+
+struct SoftRenderer {
+    int width, height, depthStride, tilesX, tilesY;
+    std::vector<uint8_t> color;  // RGB, top row first
+    std::vector<float> depth;
+    FrameUniforms frame;
+    float clearColor[3];
+    std::vector<SoftDraw> draws;
+    std::vector<std::vector<SoftTriangle>> drawTriangles;
+    std::vector<std::vector<const SoftTriangle*>> bins;
+    SoftRasterStats stats;
+};
+
+SoftRenderer createSoftRenderer(int width, int height);
+void softBeginFrame(SoftRenderer& renderer, const FrameUniforms& frame, const float clearColor[3]);
+// The mesh and texture must stay alive until softEndFrame.
+void softDrawMesh(SoftRenderer& renderer, const Mesh& mesh, const SoftTexture& texture, const ObjectUniforms& object);
+void softEndFrame(SoftRenderer& renderer, JobPool* pool);
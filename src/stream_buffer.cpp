@@ -0,0 +1,85 @@
+#include "stream_buffer.h"
+
+#include "gl_state.h"
+
+#include <chrono>
+#include <stdexcept>
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StreamBuffer createStreamBuffer(GLenum target, GLsizeiptr segmentSize, bool persistent) {
+    StreamBuffer stream = {};
+    stream.target = target;
+    stream.persistent = persistent && GLExt.bufferStorage;
+    stream.segmentSize = (segmentSize + 255) / 256 * 256;
+    glGenBuffers(1, &stream.buffer);
+    cachedBindBuffer(target, stream.buffer);
+    if (stream.persistent) {
+        GLsizeiptr total = stream.segmentSize * STREAM_BUFFER_SEGMENTS;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, nullptr, flags);
+        stream.mapped = (uint8_t*)glMapBufferRange(target, 0, total, flags);
+        if (!stream.mapped) throw std::runtime_error("Failed to map stream buffer");
+    } else {
+        glBufferData(target, stream.segmentSize, nullptr, GL_STREAM_DRAW);
+    }
+    return stream;
+}
+
+void freeStreamBuffer(StreamBuffer& stream) {
+    for (GLsync& fence : stream.fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (stream.mapped) {
+        cachedBindBuffer(stream.target, stream.buffer);
+        glUnmapBuffer(stream.target);
+    }
+    cachedDeleteBuffers(1, &stream.buffer);
+    stream = {};
+}
+
+void streamBufferBeginFrame(StreamBuffer& stream) {
+    stream.head = 0;
+    double start = nowMs();
+    if (stream.persistent) {
+        stream.segment = (stream.segment + 1) % STREAM_BUFFER_SEGMENTS;
+        GLsync& fence = stream.fences[stream.segment];
+        if (fence) {
+            GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+            while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    } else {
+        cachedBindBuffer(stream.target, stream.buffer);
+        glBufferData(stream.target, stream.segmentSize, nullptr, GL_STREAM_DRAW);
+        stream.mapped = (uint8_t*)glMapBufferRange(stream.target, 0, stream.segmentSize,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!stream.mapped) throw std::runtime_error("Failed to map stream buffer");
+    }
+    stream.waitMs += nowMs() - start;
+}
+
+StreamAllocation streamAlloc(StreamBuffer& stream, GLsizeiptr size, GLsizeiptr alignment) {
+    GLsizeiptr start = (stream.head + alignment - 1) / alignment * alignment;
+    if (start + size > stream.segmentSize) throw std::runtime_error("Stream buffer segment overflow");
+    if (!stream.mapped) throw std::runtime_error("Stream buffer allocation outside a frame");
+    stream.head = start + size;
+    GLintptr offset = stream.persistent ? stream.segment * stream.segmentSize + start : start;
+    return { stream.mapped + offset, offset };
+}
+
+void streamBufferUnmap(StreamBuffer& stream) {
+    if (stream.persistent || !stream.mapped) return;
+    cachedBindBuffer(stream.target, stream.buffer);
+    glUnmapBuffer(stream.target);
+    stream.mapped = nullptr;
+}
+
+void streamBufferEndFrame(StreamBuffer& stream) {
+    streamBufferUnmap(stream);
+    if (stream.persistent) stream.fences[stream.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "gl_ext.h"
+
+#include <cstdint>
+
+// Allocator for data rewritten every frame, such as animated or procedurally generated
+// vertices. With GL_ARB_buffer_storage the buffer is mapped once, persistently and
+// coherently, and split into one segment per frame in flight; a segment is written again
+// only after the fence of the frame that last used it has signalled. On GL 3.3 every frame
+// orphans the buffer with glBufferData and maps the fresh storage, so the driver hands out
+// new memory instead of waiting for the GPU to finish with the old.
+// Allocations are made between streamBufferBeginFrame and streamBufferUnmap and are valid
+// for that frame's draws.
+
+const int STREAM_BUFFER_SEGMENTS = 3;
+
+struct StreamAllocation {
+    void* data;
+    GLintptr offset;
+};
+
+struct StreamBuffer {
+    GLenum target;
+    GLuint buffer;
+    bool persistent;
+    uint8_t* mapped;  // whole-buffer mapping when persistent, else this frame's mapping or null
+    GLsizeiptr segmentSize;
+    GLsizeiptr head;
+    int segment;
+    GLsync fences[STREAM_BUFFER_SEGMENTS];
+    double waitMs;  // time spent waiting on fences or orphaning and mapping, accumulated
+};
+
+// persistent is ignored without GL_ARB_buffer_storage.
+StreamBuffer createStreamBuffer(GLenum target, GLsizeiptr segmentSize, bool persistent = true);
+void freeStreamBuffer(StreamBuffer& stream);
+void streamBufferBeginFrame(StreamBuffer& stream);
+// Throws when the frame's segment is full.
+StreamAllocation streamAlloc(StreamBuffer& stream, GLsizeiptr size, GLsizeiptr alignment = 16);
+// Must precede draws that read the frame's allocations; does nothing for persistent buffers.
+void streamBufferUnmap(StreamBuffer& stream);
+void streamBufferEndFrame(StreamBuffer& stream);
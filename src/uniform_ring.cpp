@@ -0,0 +1,75 @@
+#include "uniform_ring.h"
+
+#include "gl_state.h"
+
+#include <cstring>
+#include <stdexcept>
+
+UniformRing createUniformRing(GLsizeiptr blockSize, GLsizeiptr blocksPerFrame) {
+    UniformRing ring = {};
+    GLint align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    ring.alignment = align;
+    ring.segmentSize = (blockSize + align - 1) / align * align * blocksPerFrame;
+
+    GLsizeiptr total = ring.segmentSize * UNIFORM_RING_SEGMENTS;
+    glGenBuffers(1, &ring.buffer);
+    cachedBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+    if (GLExt.bufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, total, nullptr, flags);
+        ring.mapped = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, total, nullptr, GL_DYNAMIC_DRAW);
+    }
+    cachedBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return ring;
+}
+
+void freeUniformRing(UniformRing& ring) {
+    for (GLsync& fence : ring.fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (ring.mapped) {
+        cachedBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        cachedBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    cachedDeleteBuffers(1, &ring.buffer);
+    ring = {};
+}
+
+void uniformRingBeginFrame(UniformRing& ring) {
+    ring.segment = (ring.segment + 1) % UNIFORM_RING_SEGMENTS;
+    ring.head = 0;
+    GLsync& fence = ring.fences[ring.segment];
+    if (!fence) return;
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void uniformRingEndFrame(UniformRing& ring) {
+    ring.fences[ring.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr uniformRingPush(UniformRing& ring, const void* data, GLsizeiptr size) {
+    GLsizeiptr aligned = (size + ring.alignment - 1) / ring.alignment * ring.alignment;
+    if (ring.head + aligned > ring.segmentSize) throw std::runtime_error("Uniform ring segment overflow");
+    GLintptr offset = ring.segment * ring.segmentSize + ring.head;
+    ring.head += aligned;
+    if (ring.mapped) {
+        memcpy(ring.mapped + offset, data, (size_t)size);
+    } else {
+        cachedBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    return offset;
+}
+
+void uniformRingBindBlock(UniformRing& ring, GLuint binding, const void* data, GLsizeiptr size) {
+    GLintptr offset = uniformRingPush(ring, data, size);
+    cachedBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.buffer, offset, size);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "gl_ext.h"
+
+#include <cstdint>
+
+// Uniform buffer ring split into one segment per frame in flight. Each segment is
+// fenced when its frame is submitted and waited on before it is written again, so
+// filling a block is a memcpy into persistently mapped memory plus a glBindBufferRange.
+// Without GL_ARB_buffer_storage the ring falls back to glBufferSubData per block.
+
+const int UNIFORM_RING_SEGMENTS = 3;
+
+struct UniformRing {
+    GLuint buffer;
+    uint8_t* mapped;
+    GLsizeiptr segmentSize;
+    GLsizeiptr alignment;
+    GLsizeiptr head;
+    int segment;
+    GLsync fences[UNIFORM_RING_SEGMENTS];
+};
+
+// Each segment holds blocksPerFrame blocks of up to blockSize bytes, each padded to
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+UniformRing createUniformRing(GLsizeiptr blockSize, GLsizeiptr blocksPerFrame);
+void freeUniformRing(UniformRing& ring);
+void uniformRingBeginFrame(UniformRing& ring);
+void uniformRingEndFrame(UniformRing& ring);
+GLintptr uniformRingPush(UniformRing& ring, const void* data, GLsizeiptr size);
+void uniformRingBindBlock(UniformRing& ring, GLuint binding, const void* data, GLsizeiptr size);